@@ -4,27 +4,430 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <memory>
-#include <queue>
 #include <cassert>
 #include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <type_traits>
+#include <random>
+#ifndef __PROFILE_HPP__
+#define __PROFILE_HPP__
+
+#ifndef __TOKI_HPP__
+#define __TOKI_HPP__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TOKI_HAS_TSC 1
+#endif
+
+struct Timer {
+
+    static constexpr double calibration_time = 2e-3;
+    double global_start;
+    bool use_tsc;
+    uint64_t tsc_base;              // tsc reading taken at time_base
+    double time_base;
+    double seconds_per_tick;
+
+    Timer() : global_start(0), use_tsc(false), tsc_base(0), time_base(0), seconds_per_tick(0) {
+        calibrate();
+    }
+
+    static double steady() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static bool invariant_tsc() {
+#ifdef TOKI_HAS_TSC
+        unsigned int a, b, c, d;
+        return __get_cpuid(0x80000007, &a, &b, &c, &d) && (d >> 8 & 1);
+#else
+        return false;
+#endif
+    }
+
+    void calibrate() {
+        use_tsc = false;
+#ifdef TOKI_HAS_TSC
+        if(!invariant_tsc()) {
+            return;
+        }
+        const double t0 = steady();
+        const uint64_t c0 = __rdtsc();
+        double t1 = t0;
+        while(t1 - t0 < calibration_time) {
+            t1 = steady();
+        }
+        const uint64_t c1 = __rdtsc();
+        if(c1 <= c0) {
+            return;
+        }
+        seconds_per_tick = (t1 - t0) / (c1 - c0);
+        tsc_base = c1;
+        time_base = t1;
+        use_tsc = true;
+#endif
+    }
+
+    double gettime() const {
+#ifdef TOKI_HAS_TSC
+        if(use_tsc) {
+            return time_base + (int64_t)(__rdtsc() - tsc_base) * seconds_per_tick;
+        }
+#endif
+        return steady();
+    }
+
+    void init() {
+        global_start = gettime();
+    }
+
+    double elapsed() const {
+        return gettime() - global_start;
+    }
+} toki;
+
+#endif
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
 
 using namespace std;
 
-constexpr int n = 5;
-constexpr int MAX_TURN = 10000;
+namespace profile {
+
+enum Phase {
+    update1,
+    update2,
+    update3,
+    update_cr_tasks,
+    assign_tasks,
+    lookahead,
+    plan_paths,
+    get_next_action,
+    neighbour,
+    solver_000,
+    solver_001,
+    solver_002,
+    solver_003,
+    phase_count,
+};
+
+constexpr const char* phase_names[phase_count] = {
+    "update1",
+    "update2",
+    "update3",
+    "update_cr_tasks",
+    "assign_tasks",
+    "lookahead",
+    "plan_paths",
+    "get_next_action",
+    "neighbour",
+    "solver_000",
+    "solver_001",
+    "solver_002",
+    "solver_003",
+};
+
+enum Counter {
+    anneal_iterations,
+    anneal_accepted,
+    restarts,
+    beam_nodes,
+    counter_count,
+};
+
+constexpr const char* counter_names[counter_count] = {
+    "anneal_iterations",
+    "anneal_accepted",
+    "restarts",
+    "beam_nodes",
+};
+
+struct Table {
+    long long calls[phase_count] = {};
+    double time[phase_count] = {};
+    long long count[counter_count] = {};
+    void add(const Table& other) {
+        for(int k = 0; k < phase_count; k++) {
+            calls[k] += other.calls[k];
+            time[k] += other.time[k];
+        }
+        for(int k = 0; k < counter_count; k++) {
+            count[k] += other.count[k];
+        }
+    }
+};
+
+struct Registry {
+    mutex mtx;
+    Table retired;
+    vector<const Table*> live;
+};
+
+Registry& registry() {
+    static Registry reg;
+    return reg;
+}
+
+struct LocalTable : Table {
+    LocalTable() {
+        Registry& reg = registry();
+        lock_guard<mutex> lock(reg.mtx);
+        reg.live.push_back(this);
+    }
+    ~LocalTable() {
+        Registry& reg = registry();
+        lock_guard<mutex> lock(reg.mtx);
+        reg.retired.add(*this);
+        erase(reg.live, this);
+    }
+};
 
-enum ObjectType {
-    CRANE,
-    CONTAINER,
+Table& local() {
+    thread_local LocalTable table;
+    return table;
+}
+
+struct Scope {
+    Phase phase;
+    double start;
+    explicit Scope(Phase _phase) : phase(_phase), start(toki.gettime()) {}
+    ~Scope() {
+        Table& table = local();
+        table.calls[phase]++;
+        table.time[phase] += toki.gettime() - start;
+    }
+};
+
+void report(ostream& os) {
+#ifdef AHC_PROFILE
+    Registry& reg = registry();
+    lock_guard<mutex> lock(reg.mtx);
+    Table total = reg.retired;
+    for(const Table* table : reg.live) {
+        total.add(*table);
+    }
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << fixed << setprecision(6);
+    for(int k = 0; k < phase_count; k++) {
+        os << "profile_" << phase_names[k] << "_calls = " << total.calls[k] << "\n";
+        os << "profile_" << phase_names[k] << "_time = " << total.time[k] << "\n";
+    }
+    for(int k = 0; k < counter_count; k++) {
+        os << "profile_" << counter_names[k] << "_count = " << total.count[k] << "\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+    os.flush();
+#else
+    (void)os;
+#endif
+}
+
+} // namespace profile
+
+#ifdef AHC_PROFILE
+#define PROFILE_SCOPE(phase) const profile::Scope profile_scope(profile::phase)
+#define PROFILE_COUNT(counter) (profile::local().count[profile::counter]++)
+#else
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_COUNT(counter) ((void)0)
+#endif
+
+#endif
+#ifndef __LOGGER_HPP__
+#define __LOGGER_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+#ifndef AHC_LOG_LEVEL
+#define AHC_LOG_LEVEL 3
+#endif
+
+namespace logger {
+
+enum Level {
+    TRACE,
+    DEBUG,
+    INFO,
+    WARN,
+    ERROR,
+};
+
+constexpr bool enabled(Level level) { return level >= AHC_LOG_LEVEL; }
+
+constexpr size_t ring_capacity = 1 << 16;
+constexpr size_t line_capacity = 1 << 10;
+
+struct Ring {
+    char data[ring_capacity];
+    size_t written = 0;
+    atomic<bool> in_use{false};
+    void append(const char* s, size_t len) {
+        for(size_t k = 0; k < len; k++) {
+            data[(written + k) % ring_capacity] = s[k];
+        }
+        written += len;
+    }
+    void dump(int fd) const {
+        const size_t size = min(written, ring_capacity);
+        const size_t start = (written - size) % ring_capacity;
+        const size_t first = min(size, ring_capacity - start);
+        if(write(fd, data + start, first) < 0 || write(fd, data, size - first) < 0) {
+            return;
+        }
+    }
+};
+
+struct Registry {
+    mutex mtx;
+    vector<unique_ptr<Ring>> rings;
+};
+
+Registry& registry() {
+    static Registry reg;
+    return reg;
+}
+
+struct Claim {
+    Ring* ring = nullptr;
+    Claim() {
+        Registry& reg = registry();
+        lock_guard<mutex> lock(reg.mtx);
+        for(const auto& r : reg.rings) {
+            if(!r->in_use.exchange(true)) {
+                ring = r.get();
+                return;
+            }
+        }
+        reg.rings.push_back(make_unique<Ring>());
+        ring = reg.rings.back().get();
+        ring->in_use = true;
+    }
+    ~Claim() { ring->in_use = false; }
+};
+
+Ring& ring() {
+    thread_local Claim claim;
+    return *claim.ring;
+}
+
+struct LineBuffer : streambuf {
+    char data[line_capacity];
+    void reset() { setp(data, data + line_capacity); }
+    size_t size() const { return pptr() - pbase(); }
+};
+
+struct Line {
+    static constexpr const char* tags[] = {"[T] ", "[D] ", "[I] ", "[W] ", "[E] "};
+    Level level;
+    LineBuffer& buf;
+    ostream& os;
+    static LineBuffer& local_buffer() {
+        thread_local LineBuffer buf;
+        return buf;
+    }
+    static ostream& local_stream() {
+        thread_local ostream os(&local_buffer());
+        return os;
+    }
+    explicit Line(Level _level) : level(_level), buf(local_buffer()), os(local_stream()) {
+        buf.reset();
+        os.clear();
+    }
+    ~Line() {
+        Ring& r = ring();
+        r.append(tags[level], 4);
+        r.append(buf.data, buf.size());
+        r.append("\n", 1);
+        if(level >= INFO) {
+            cerr.write(buf.data, buf.size()) << endl;
+        }
+    }
 };
 
-enum CraneType {
+void dump(int fd) {
+    Registry& reg = registry();
+    for(size_t k = 0; k < reg.rings.size(); k++) {
+        const Ring& r = *reg.rings[k];
+        if(r.written == 0) {
+            continue;
+        }
+        const char header[] = "--- log ring ---\n";
+        if(write(fd, header, sizeof(header) - 1) < 0) {
+            return;
+        }
+        r.dump(fd);
+    }
+}
+
+void dump() {
+    Registry& reg = registry();
+    lock_guard<mutex> lock(reg.mtx);
+    cerr.flush();
+    dump(STDERR_FILENO);
+}
+
+void crash_handler(int sig) {
+    dump(STDERR_FILENO);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void install_crash_handler() {
+    if constexpr (enabled(ERROR)) {
+        signal(SIGABRT, crash_handler);
+        signal(SIGSEGV, crash_handler);
+    }
+}
+
+} // namespace logger
+
+#define AHC_LOG(level, message) \
+    do { \
+        if constexpr (logger::enabled(logger::level)) { \
+            logger::Line(logger::level).os << message; \
+        } \
+    } while(0)
+
+#define LOG_TRACE(message) AHC_LOG(TRACE, message)
+#define LOG_DEBUG(message) AHC_LOG(DEBUG, message)
+#define LOG_INFO(message) AHC_LOG(INFO, message)
+#define LOG_WARN(message) AHC_LOG(WARN, message)
+#define LOG_ERROR(message) AHC_LOG(ERROR, message)
+
+#endif
+
+using namespace std;
+
+constexpr int n = 5;
+constexpr int MAX_TURN = 10000;
+
+enum CraneType : int8_t {
     LARGE,
     SMALL,
 };
 
-enum CraneStatus {
+enum CraneStatus : int8_t {
     FREE,
     PRE_CATCH,
     CATCH_NOW,
@@ -44,65 +447,147 @@ enum ActionType {
     DESTROYED,
 };
 
-struct Object {
-    int i, j;
-    int id;
-    ObjectType obj_type;
-    Object(int i, int j, int id, ObjectType obj_type) : i(i), j(j), id(id), obj_type(obj_type) {}
-    virtual ~Object() = default;
+enum SimError : int8_t {
+    ERR_NONE,
+    ERR_OUT_OF_GRID,
+    ERR_COLLISION,
+    ERR_SWAP,
+    ERR_SMALL_OVER_CONTAINER,
+    ERR_CATCH_EMPTY,
+    ERR_CATCH_HOLDING,
+    ERR_RELEASE_EMPTY,
+    ERR_RELEASE_OCCUPIED,
+    ERR_BOMB_HOLDING,
+    ERR_DESTROYED_CRANE,        // a bombed crane was given something other than DESTROYED
+    ERR_DESTROYED_ACTION,       // DESTROYED was given to a crane that still exists
 };
 
-struct Container : Object {
-    int out_i;
-    Container(int i, int j, int id, int out_i) : Object(i, j, id, ObjectType::CONTAINER), out_i(out_i) {}
+struct SimStatus {
+    SimError error;
+    int turn;
+    int8_t crane;
+    bool ok() const { return error == SimError::ERR_NONE; }
 };
 
-struct Crane : Object {
+struct Crane {
+    int8_t i, j;
     CraneType crane_type;
-    shared_ptr<Container> container;
-    bool exist;
     CraneStatus status;
-    int catch_i, catch_j;
-    int release_i, release_j;
-    int prev_container_id;
-    Crane(int i, int j, int id, CraneType crane_type) : Object(i, j, id, ObjectType::CRANE), crane_type(crane_type), container(nullptr), exist(true), prev_container_id(-1) {} 
+    bool exist;
+    int8_t container;  // held container id, -1 if none
+    int8_t catch_i, catch_j;
+    int8_t release_i, release_j;
+    int8_t prev_container_id;
     void set_catch_and_release(int, int, int, int);
 };
 
 struct Input {
     vector<vector<int>> a;
-    void read();
+    void read(istream& is = cin);
+};
+
+struct Zobrist {
+    uint64_t crane[n][n*n];         // crane k standing on cell
+    uint64_t hold[n][n*n];          // crane k holding container id
+    uint64_t cell[n*n][n*n];        // container id lying on cell
+    uint64_t queue_head[n][n+1];    // arrival queue of row i popped head times
+    uint64_t out_count[n][n*n+1];   // outlet i received count containers
+    Zobrist();
+} zobrist;
+
+Zobrist::Zobrist() {
+    mt19937_64 engine(0x5eed);
+    for(auto& row : crane) for(auto& x : row) x = engine();
+    for(auto& row : hold) for(auto& x : row) x = engine();
+    for(auto& row : cell) for(auto& x : row) x = engine();
+    for(auto& row : queue_head) for(auto& x : row) x = engine();
+    for(auto& row : out_count) for(auto& x : row) x = engine();
+}
+
+struct Terminal;
+
+enum UndoType : int8_t {
+    UNDO_HEADER,     // turn_count, occupancy masks and hash at the start of an update
+    UNDO_CRANE,      // whole Crane record before it moved / caught / released
+    UNDO_CELL,       // container_id byte before a catch / release / arrival
+    UNDO_QUEUE_POP,  // a container left the arrival queue of row idx
+    UNDO_COLLECT,    // a container was carried out of outlet idx
+};
+
+struct UndoEntry {
+    UndoType type;
+    int8_t idx;
+    int8_t cell_id;
+    Crane crane;
+    int turn_count;
+    uint32_t crane_mask, container_mask;
+    uint64_t hash;
+};
+
+struct UndoLog {
+    vector<UndoEntry> entries;
+    int mark() const { return entries.size(); }
+    void clear() { entries.clear(); }
+    void record_header(const Terminal&);
+    void record_crane(const Terminal&, int k);
+    void record_cell(const Terminal&, int cell);
+    void record_queue_pop(int i);
+    void record_collect(int i);
 };
 
 struct Terminal {
     int turn_count;
-    vector<shared_ptr<Crane>> cranes;
-    vector<shared_ptr<Container>> containers;
-    vector<queue<shared_ptr<Container>>> container_queue;
-    vector<vector<shared_ptr<Crane>>> crane_pos;
-    vector<vector<shared_ptr<Container>>> container_pos;
-    vector<vector<shared_ptr<Container>>> collected_containers;
+    uint32_t crane_mask;
+    uint32_t container_mask;
+    int8_t container_id[n*n];       // container id on each cell, -1 if empty
+    Crane cranes[n];
+    int8_t queue[n][n];             // arrival order of each row
+    int8_t queue_head[n];
+    int8_t collected[n*n];          // carried-out containers in order (any outlet may receive up to n*n)
+    int8_t collected_row[n*n];      // outlet row of collected[k]
+    int8_t collected_count;
+    int8_t out_count[n];            // carried-out containers per outlet row
+    uint64_t hash;                  // Zobrist hash of everything above except turn_count
     void init(const Input&);
-    void update1();
-    void update2(const vector<ActionType>&);
-    void update3();
-    void watch();
+    void update1(UndoLog* log = nullptr);
+    void update2(const vector<ActionType>& actions, UndoLog* log = nullptr) { PROFILE_SCOPE(update2); step2<false>(actions.data(), log); }
+    SimStatus referee2(const vector<ActionType>& actions, UndoLog* log = nullptr) { return step2<true>(actions.data(), log); }
+    template<bool REFEREE> SimStatus step2(const ActionType* actions, UndoLog* log);
+    SimStatus check2(const ActionType* actions) const;
+    void update3(UndoLog* log = nullptr);
+    void rollback(UndoLog& log, int mark);
+    void watch(ostream& os = cerr) const;
+    bool has_crane(int i, int j) const { return crane_mask >> (i*n+j) & 1; }
+    bool has_container(int i, int j) const { return container_mask >> (i*n+j) & 1; }
+    int container_at(int i, int j) const { return has_container(i, j) ? container_id[i*n+j] : -1; }
+    int crane_at(int i, int j) const;
+    bool queue_empty(int i) const { return queue_head[i] == n; }
+    int remaining_containers() const;
+    pair<int, int> find_container(int id) const;
+    uint64_t calc_hash() const;
 };
 
+static_assert(is_trivially_copyable_v<Terminal>);
+
 namespace common {
     char act2char(const ActionType);
+    ActionType char2act(const char);
     pair<int, int> act2move(const ActionType);
     int calc_out_i(int id);
-    void print(const vector<vector<ActionType>>&);
+    void print(const vector<vector<ActionType>>&, ostream& os = cout);
+    SimStatus referee(const Input&, const vector<vector<ActionType>>&, Terminal* last = nullptr);
+    constexpr long long INVALID_SCORE = 1LL<<60;
+    long long score(const Input&, const vector<vector<ActionType>>&);
+    long long score(const Terminal& last, long long turns);
 };
 
-void Input::read() {
+void Input::read(istream& is) {
     int n;
-    cin >> n;
+    is >> n;
     a.resize(n, vector<int>(n));
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            cin >> a[i][j];
+            is >> a[i][j];
         }
     }
 }
@@ -116,154 +601,369 @@ void Crane::set_catch_and_release(int _catch_i, int _catch_j, int _release_i, in
     release_j = _release_j;
 }
 
-void common::print(const vector<vector<ActionType>>& actions) {
+void common::print(const vector<vector<ActionType>>& actions, ostream& os) {
     for(int i = 0; i < n; i++) {
         for(const ActionType act: actions[i]) {
             if(act != ActionType::DESTROYED) {
-                cout << common::act2char(act);
+                os << common::act2char(act);
             }
         }
-        cout << endl;
+        os << endl;
     }
 }
 
 void Terminal::init(const Input& in) {
     turn_count = 0;
-    crane_pos.resize(n, vector<shared_ptr<Crane>>(n, nullptr));
-    container_pos.resize(n, vector<shared_ptr<Container>>(n, nullptr));
-    container_queue.resize(n);
-    collected_containers.resize(n);
-    cranes.resize(n);
-    containers.resize(n*n);
+    crane_mask = 0;
+    container_mask = 0;
+    memset(container_id, -1, sizeof(container_id));
     for(int i = 0; i < n; i++) {
-        cranes[i] = make_shared<Crane>(i, 0, i, (i == 0 ? CraneType::LARGE : CraneType::SMALL));
+        Crane& c = cranes[i];
+        c.i = i;
+        c.j = 0;
+        c.crane_type = (i == 0 ? CraneType::LARGE : CraneType::SMALL);
+        c.status = CraneStatus::FREE;
+        c.exist = true;
+        c.container = -1;
+        c.catch_i = c.catch_j = c.release_i = c.release_j = -1;
+        c.prev_container_id = -1;
+        crane_mask |= 1u << (i*n);
     }
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            containers[in.a[i][j]] = make_shared<Container>(i, 0, in.a[i][j], common::calc_out_i(in.a[i][j]));
-            container_queue[i].push(containers[in.a[i][j]]);
+            queue[i][j] = in.a[i][j];
         }
+        queue_head[i] = 0;
     }
+    memset(collected, -1, sizeof(collected));
+    memset(collected_row, -1, sizeof(collected_row));
+    collected_count = 0;
+    memset(out_count, 0, sizeof(out_count));
+    hash = calc_hash();
 }
 
-void Terminal::update1() {
+void Terminal::update1(UndoLog* log) {
+    PROFILE_SCOPE(update1);
+    if(log) log->record_header(*this);
     turn_count++;
     for(int i = 0; i < n; i++) {
-        if(container_queue[i].empty()) {
+        if(queue_empty(i)) {
+            continue;
+        }
+        const int cell = i*n;
+        if(has_container(i, 0)) {
+            continue;
+        }
+        if(has_crane(i, 0) && cranes[crane_at(i, 0)].container != -1) {
             continue;
         }
-        shared_ptr<Container> c = container_queue[i].front();
-        if( (!container_pos[c->i][c->j]) && 
-            ((!crane_pos[c->i][c->j]) || (!crane_pos[c->i][c->j]->container)) ) {
-            container_pos[c->i][c->j] = move(c);
-            container_queue[i].pop();
-        }   
+        if(log) {
+            log->record_cell(*this, cell);
+            log->record_queue_pop(i);
+        }
+        container_mask |= 1u << cell;
+        container_id[cell] = queue[i][queue_head[i]];
+        hash ^= zobrist.cell[cell][container_id[cell]];
+        hash ^= zobrist.queue_head[i][queue_head[i]] ^ zobrist.queue_head[i][queue_head[i]+1];
+        queue_head[i]++;
+    }
+}
+
+SimStatus Terminal::check2(const ActionType* actions) const {
+    int old_cell[n], new_cell[n];
+    bool occupy[n];
+    for(int k = 0; k < n; k++) {
+        const Crane& crane = cranes[k];
+        const ActionType act = actions[k];
+        const bool holding = crane.container != -1;
+        const auto [di, dj] = common::act2move(act);
+        const int ni = crane.i + di;
+        const int nj = crane.j + dj;
+        old_cell[k] = crane.i*n + crane.j;
+        new_cell[k] = ni*n + nj;
+        occupy[k] = crane.exist && act != ActionType::BOMB;
+        SimError err = SimError::ERR_NONE;
+        if(!crane.exist) {
+            if(act != ActionType::DESTROYED) err = SimError::ERR_DESTROYED_CRANE;
+        } else if(act == ActionType::DESTROYED) {
+            err = SimError::ERR_DESTROYED_ACTION;
+        } else if(ni < 0 || nj < 0 || ni >= n || nj >= n) {
+            err = SimError::ERR_OUT_OF_GRID;
+        }
+        for(int m = 0; m < k && err == SimError::ERR_NONE; m++) {
+            if(!occupy[k] || !occupy[m]) continue;
+            if(new_cell[k] == new_cell[m]) err = SimError::ERR_COLLISION;
+            else if(new_cell[k] == old_cell[m] && new_cell[m] == old_cell[k]) err = SimError::ERR_SWAP;
+        }
+        if(err == SimError::ERR_NONE && crane.exist) {
+            const bool moved = di != 0 || dj != 0;
+            const bool on_container = container_mask >> old_cell[k] & 1;
+            if(crane.crane_type == CraneType::SMALL && moved && holding && (container_mask >> new_cell[k] & 1)) err = SimError::ERR_SMALL_OVER_CONTAINER;
+            else if(act == ActionType::CATCH && !on_container) err = SimError::ERR_CATCH_EMPTY;
+            else if(act == ActionType::CATCH && holding) err = SimError::ERR_CATCH_HOLDING;
+            else if(act == ActionType::RELEASE && !holding) err = SimError::ERR_RELEASE_EMPTY;
+            else if(act == ActionType::RELEASE && on_container) err = SimError::ERR_RELEASE_OCCUPIED;
+            else if(act == ActionType::BOMB && holding) err = SimError::ERR_BOMB_HOLDING;
+        }
+        if(err != SimError::ERR_NONE) {
+            return SimStatus{err, turn_count, (int8_t)k};
+        }
     }
+    return SimStatus{SimError::ERR_NONE, turn_count, -1};
 }
 
-void Terminal::update2(const vector<ActionType>& actions) {
-    vector next_crane_pos(n, vector<shared_ptr<Crane>>(n, nullptr));
+template<bool REFEREE>
+SimStatus Terminal::step2(const ActionType* actions, UndoLog* log) {
+    if constexpr (REFEREE) {
+        const SimStatus status = check2(actions);
+        if(!status.ok()) {
+            return status;
+        }
+    }
+    if(log) log->record_header(*this);
+    uint32_t next_crane_mask = 0;
     for(int i = 0; i < n; i++) {
-        if(!cranes[i]->exist) {
-            assert(actions[i] == ActionType::DESTROYED);
+        Crane& crane = cranes[i];
+        if(!crane.exist) {
             continue;
         }
+        if(log) log->record_crane(*this, i);
         auto [di, dj] = common::act2move(actions[i]);
-        const int next_i = cranes[i]->i + di;
-        const int next_j = cranes[i]->j + dj;
-        next_crane_pos[next_i][next_j] = cranes[i];
-        cranes[i]->i = next_i;
-        cranes[i]->j = next_j;
-        if(cranes[i]->container) {
-            cranes[i]->container->i = next_i;
-            cranes[i]->container->j = next_j;
+        const int next_i = crane.i + di;
+        const int next_j = crane.j + dj;
+        if(actions[i] != ActionType::BOMB) {
+            next_crane_mask |= 1u << (next_i*n+next_j);
         }
-        assert(cranes[i] == next_crane_pos[next_i][next_j]);
-        if(cranes[i]->status == CraneStatus::PRE_CATCH) {
-            if(cranes[i]->i == cranes[i]->catch_i && cranes[i]->j == cranes[i]->catch_j) {
-                cranes[i]->status = CraneStatus::CATCH_NOW;
+        hash ^= zobrist.crane[i][crane.i*n+crane.j] ^ zobrist.crane[i][next_i*n+next_j];
+        crane.i = next_i;
+        crane.j = next_j;
+        const int cell = next_i*n + next_j;
+        if(crane.status == CraneStatus::PRE_CATCH) {
+            if(crane.i == crane.catch_i && crane.j == crane.catch_j) {
+                crane.status = CraneStatus::CATCH_NOW;
             }
         }
-        else if(cranes[i]->status == CraneStatus::PRE_RELEASE) {
-            if(cranes[i]->i == cranes[i]->release_i && cranes[i]->j == cranes[i]->release_j) {
-                cranes[i]->status = CraneStatus::RELEASE_NOW;
+        else if(crane.status == CraneStatus::PRE_RELEASE) {
+            if(crane.i == crane.release_i && crane.j == crane.release_j) {
+                crane.status = CraneStatus::RELEASE_NOW;
             }
         }
         if(actions[i] == ActionType::CATCH) {
-            assert(container_pos[cranes[i]->i][cranes[i]->j]);
-            assert(!cranes[i]->container);
-            cranes[i]->container = move(container_pos[cranes[i]->i][cranes[i]->j]);
-            cranes[i]->prev_container_id = cranes[i]->container->id;
-            cranes[i]->status = CraneStatus::PRE_RELEASE;
+            if(log) log->record_cell(*this, cell);
+            crane.container = container_id[cell];
+            hash ^= zobrist.cell[cell][crane.container] ^ zobrist.hold[i][crane.container];
+            container_id[cell] = -1;
+            container_mask &= ~(1u << cell);
+            crane.prev_container_id = crane.container;
+            crane.status = CraneStatus::PRE_RELEASE;
         }
         if(actions[i] == ActionType::RELEASE) {
-            assert(cranes[i]->container);
-            if(container_pos[cranes[i]->i][cranes[i]->j]) {
-                cerr << cranes[i]->status << endl;
-                cerr << cranes[i]->container->id << ", " << container_pos[cranes[i]->i][cranes[i]->j]->id << endl;
-            }
-            assert(!container_pos[cranes[i]->i][cranes[i]->j]);
-            container_pos[cranes[i]->i][cranes[i]->j] = move(cranes[i]->container);
-            assert(container_pos[cranes[i]->i][cranes[i]->j]->i == cranes[i]->i &&
-                   container_pos[cranes[i]->i][cranes[i]->j]->j == cranes[i]->j );
-            cranes[i]->status = CraneStatus::FREE;
+            if(log) log->record_cell(*this, cell);
+            container_mask |= 1u << cell;
+            container_id[cell] = crane.container;
+            hash ^= zobrist.cell[cell][crane.container] ^ zobrist.hold[i][crane.container];
+            crane.container = -1;
+            crane.status = CraneStatus::FREE;
         }
         if(actions[i] == ActionType::BOMB) {
-            assert(!cranes[i]->container);
-            cranes[i]->exist = false;
-            next_crane_pos[cranes[i]->i][cranes[i]->j] = nullptr;
+            crane.exist = false;
+            hash ^= zobrist.crane[i][cell];
         }
     }
-    crane_pos = move(next_crane_pos);
+    crane_mask = next_crane_mask;
+    return SimStatus{SimError::ERR_NONE, turn_count, -1};
 }
 
-void Terminal::update3() {
+void Terminal::update3(UndoLog* log) {
+    PROFILE_SCOPE(update3);
+    if(log) log->record_header(*this);
     for(int i = 0; i < n; i++) {
-        if(container_pos[i][n-1]) {
-            collected_containers[i].push_back(container_pos[i][n-1]);
-            container_pos[i][n-1] = nullptr;
+        const int cell = i*n + n-1;
+        if(container_mask >> cell & 1) {
+            if(log) {
+                log->record_cell(*this, cell);
+                log->record_collect(i);
+            }
+            collected[collected_count] = container_id[cell];
+            collected_row[collected_count] = i;
+            collected_count++;
+            hash ^= zobrist.cell[cell][container_id[cell]];
+            hash ^= zobrist.out_count[i][out_count[i]] ^ zobrist.out_count[i][out_count[i]+1];
+            out_count[i]++;
+            container_id[cell] = -1;
+            container_mask &= ~(1u << cell);
+        }
+    }
+}
+
+void Terminal::rollback(UndoLog& log, int mark) {
+    while(log.mark() > mark) {
+        const UndoEntry& e = log.entries.back();
+        if(e.type == UndoType::UNDO_HEADER) {
+            turn_count = e.turn_count;
+            crane_mask = e.crane_mask;
+            container_mask = e.container_mask;
+            hash = e.hash;
+        } else if(e.type == UndoType::UNDO_CRANE) {
+            cranes[e.idx] = e.crane;
+        } else if(e.type == UndoType::UNDO_CELL) {
+            container_id[e.idx] = e.cell_id;
+        } else if(e.type == UndoType::UNDO_QUEUE_POP) {
+            queue_head[e.idx]--;
+        } else if(e.type == UndoType::UNDO_COLLECT) {
+            collected_count--;
+            out_count[collected_row[collected_count]]--;
+            collected[collected_count] = -1;
+            collected_row[collected_count] = -1;
+        }
+        log.entries.pop_back();
+    }
+}
+
+void UndoLog::record_header(const Terminal& term) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_HEADER;
+    e.turn_count = term.turn_count;
+    e.crane_mask = term.crane_mask;
+    e.container_mask = term.container_mask;
+    e.hash = term.hash;
+    entries.push_back(e);
+}
+
+void UndoLog::record_crane(const Terminal& term, int k) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_CRANE;
+    e.idx = k;
+    e.crane = term.cranes[k];
+    entries.push_back(e);
+}
+
+void UndoLog::record_cell(const Terminal& term, int cell) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_CELL;
+    e.idx = cell;
+    e.cell_id = term.container_id[cell];
+    entries.push_back(e);
+}
+
+void UndoLog::record_queue_pop(int i) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_QUEUE_POP;
+    e.idx = i;
+    entries.push_back(e);
+}
+
+void UndoLog::record_collect(int i) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_COLLECT;
+    e.idx = i;
+    entries.push_back(e);
+}
+
+int Terminal::crane_at(int i, int j) const {
+    if(!has_crane(i, j)) {
+        return -1;
+    }
+    for(int k = 0; k < n; k++) {
+        if(cranes[k].exist && cranes[k].i == i && cranes[k].j == j) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+int Terminal::remaining_containers() const {
+    return n*n - collected_count;
+}
+
+pair<int, int> Terminal::find_container(int id) const {
+    for(uint32_t mask = container_mask; mask; mask &= mask - 1) {
+        const int cell = countr_zero(mask);
+        if(container_id[cell] == id) {
+            return make_pair(cell / n, cell % n);
+        }
+    }
+    for(int k = 0; k < n; k++) {
+        if(cranes[k].exist && cranes[k].container == id) {
+            return make_pair((int)cranes[k].i, (int)cranes[k].j);
+        }
+    }
+    return make_pair(-1, -1);
+}
+
+uint64_t Terminal::calc_hash() const {
+    uint64_t res = 0;
+    for(int k = 0; k < n; k++) {
+        const Crane& c = cranes[k];
+        if(!c.exist) {
+            continue;
         }
+        res ^= zobrist.crane[k][c.i*n+c.j];
+        if(c.container != -1) {
+            res ^= zobrist.hold[k][c.container];
+        }
+    }
+    for(uint32_t mask = container_mask; mask; mask &= mask - 1) {
+        const int cell = countr_zero(mask);
+        res ^= zobrist.cell[cell][container_id[cell]];
+    }
+    for(int i = 0; i < n; i++) {
+        res ^= zobrist.queue_head[i][queue_head[i]];
+        res ^= zobrist.out_count[i][out_count[i]];
     }
+    return res;
 }
 
-void Terminal::watch() {
+void Terminal::watch(ostream& os) const {
 
-    cerr << "collected: " << collected_containers.size() << endl;
+    os << "collected: " << n*n - remaining_containers() << endl;
     for(int i = 0; i < n; i++) {
-        cerr << " " << i << ": ";
-        for(auto c: collected_containers[i]) cerr << c->id << ", ";
-        cerr << endl;
+        os << " " << i << ": ";
+        for(int k = 0; k < collected_count; k++) if(collected_row[k] == i) os << (int)collected[k] << ", ";
+        os << endl;
     }
-    cerr << endl;
+    os << endl;
 
+    os << "queue: " << endl;
+    for(int i = 0; i < n; i++) {
+        os << " " << i << ": ";
+        for(int k = queue_head[i]; k < n; k++) os << (int)queue[i][k] << ", ";
+        os << endl;
+    }
+    os << endl;
 
-    cerr << "conatiner map: " << endl;
+    os << "conatiner map: " << endl;
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            if(container_pos[i][j]) {
-                cerr << setw(2) << container_pos[i][j]->id;
+            if(has_container(i, j)) {
+                os << setw(2) << container_at(i, j);
             } else {
-                cerr << "  ";
+                os << "  ";
             }
-            cerr << "|"; 
+            os << "|"; 
         }
-        cerr << endl;
+        os << endl;
     }
-    cerr << endl;
+    os << endl;
 
-    cerr << "crane map: " << endl;
+    os << "crane map: " << endl;
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            if(crane_pos[i][j]) {
-                cerr << setw(2) << crane_pos[i][j]->id;
+            if(has_crane(i, j)) {
+                os << setw(2) << crane_at(i, j);
             } else {
-                cerr << "  ";
+                os << "  ";
             }
-            cerr << "|"; 
+            os << "|"; 
         }
-        cerr << endl;
+        os << endl;
     }
-    cerr << endl;
+    os << endl;
+}
+
+ostream& operator<<(ostream& os, const Terminal& term) {
+    term.watch(os);
+    return os;
 }
 
 char common::act2char(const ActionType act) {
@@ -278,6 +978,18 @@ char common::act2char(const ActionType act) {
     return '?';
 }
 
+ActionType common::char2act(const char c) {
+    if(c == 'P') return ActionType::CATCH;
+    if(c == 'Q') return ActionType::RELEASE;
+    if(c == 'U') return ActionType::UP;
+    if(c == 'D') return ActionType::DOWN;
+    if(c == 'L') return ActionType::LEFT;
+    if(c == 'R') return ActionType::RIGHT;
+    if(c == '.') return ActionType::WAIT;
+    if(c == 'B') return ActionType::BOMB;
+    return ActionType::DESTROYED;
+}
+
 pair<int,int> common::act2move(const ActionType act) {
     int i = 0;
     int j = 0;
@@ -292,28 +1004,271 @@ int common::calc_out_i(int id) {
     return id / n;
 }
 
+SimStatus common::referee(const Input& in, const vector<vector<ActionType>>& actions, Terminal* last) {
+    Terminal term;
+    term.init(in);
+    SimStatus status{SimError::ERR_NONE, 0, -1};
+    int turns = 0;
+    for(const auto& row : actions) {
+        turns = max(turns, (int)row.size());
+    }
+    vector<ActionType> acts(n);
+    for(int t = 0; t < turns && status.ok(); t++) {
+        for(int k = 0; k < n; k++) {
+            if(k < (int)actions.size() && t < (int)actions[k].size()) {
+                acts[k] = actions[k][t];
+            } else {
+                acts[k] = term.cranes[k].exist ? ActionType::WAIT : ActionType::DESTROYED;
+            }
+        }
+        term.update1();
+        status = term.referee2(acts);
+        if(status.ok()) {
+            term.update3();
+        }
+    }
+    if(last) {
+        *last = term;
+    }
+    return status;
+}
+
+long long common::score(const Input& in, const vector<vector<ActionType>>& actions) {
+    Terminal term;
+    if(!common::referee(in, actions, &term).ok()) {
+        return INVALID_SCORE;
+    }
+    long long turns = 0;
+    for(const auto& row : actions) {
+        long long len = 0;
+        for(const ActionType act : row) {
+            if(act != ActionType::DESTROYED) len++;
+        }
+        turns = max(turns, len);
+    }
+    return common::score(term, turns);
+}
+
+long long common::score(const Terminal& term, long long turns) {
+    if(turns > MAX_TURN) {
+        return INVALID_SCORE;
+    }
+    long long inversions = 0;
+    long long wrong = 0;
+    for(int a = 0; a < term.collected_count; a++) {
+        if(common::calc_out_i(term.collected[a]) != term.collected_row[a]) {
+            wrong++;
+        }
+        for(int b = a+1; b < term.collected_count; b++) {
+            if(term.collected_row[a] == term.collected_row[b] && term.collected[a] > term.collected[b]) {
+                inversions++;
+            }
+        }
+    }
+    const long long undelivered = term.remaining_containers();
+    return turns + 100*inversions + 10000*wrong + 1000000*undelivered;
+}
+
 #endif
 #ifndef __SOLVER_000_HPP__
 #define __SOLVER_000_HPP__
 
-#include <numeric>
-#include <algorithm>
-#include <set>
+#ifndef __ANYTIME_HPP__
+#define __ANYTIME_HPP__
 
-extern Input in;
+#ifndef __PACKED_HPP__
+#define __PACKED_HPP__
 
+#include <array>
+#include <memory>
+#include <string>
+
+struct PackedActions {
+    static constexpr int bits = 4;
+    static constexpr int turn_bits = bits * n;
+    static constexpr int turns_per_word = 64 / turn_bits;
+    static constexpr int chunk_words = 64;
+    static constexpr int chunk_turns = chunk_words * turns_per_word;
+    using Chunk = array<uint64_t, chunk_words>;
+
+    vector<shared_ptr<Chunk>> chunks;
+    int turns = 0;
+
+    int size() const { return turns; }
+    ActionType get(int t, int k) const;
+    vector<ActionType> turn(int t) const;
+    void push_back(const vector<ActionType>& actions);
+    void truncate(int t);
+
+    static PackedActions pack(const vector<vector<ActionType>>& actions);
+    vector<vector<ActionType>> unpack() const;
+    void print() const;
+    static PackedActions read(istream& is);
+};
 
-namespace solver_000 {
+ActionType PackedActions::get(int t, int k) const {
+    const uint64_t word = (*chunks[t / chunk_turns])[t % chunk_turns / turns_per_word];
+    const int shift = t % turns_per_word * turn_bits + k * bits;
+    return (ActionType)(word >> shift & ((1u << bits) - 1));
+}
 
-void copy2res(vector<vector<ActionType>>& res, const vector<ActionType>& actions) {
-    for(int i = 0; i < n; i++) {
-        res[i].push_back(actions[i]);
+vector<ActionType> PackedActions::turn(int t) const {
+    vector<ActionType> res(n);
+    for(int k = 0; k < n; k++) {
+        res[k] = get(t, k);
     }
+    return res;
 }
 
-vector<vector<ActionType>> solve() {
+void PackedActions::push_back(const vector<ActionType>& actions) {
+    const int c = turns / chunk_turns;
+    if(c == (int)chunks.size()) {
+        chunks.push_back(make_shared<Chunk>());
+    } else if(chunks[c].use_count() > 1) {
+        chunks[c] = make_shared<Chunk>(*chunks[c]);
+    }
+    uint64_t packed = 0;
+    for(int k = 0; k < n; k++) {
+        packed |= (uint64_t)actions[k] << (k * bits);
+    }
+    uint64_t& word = (*chunks[c])[turns % chunk_turns / turns_per_word];
+    const int shift = turns % turns_per_word * turn_bits;
+    word = (word & ~(((1ull << turn_bits) - 1) << shift)) | packed << shift;
+    turns++;
+}
 
-    vector<vector<ActionType>> res(n);
+void PackedActions::truncate(int t) {
+    assert(0 <= t && t <= turns);
+    turns = t;
+    chunks.resize((t + chunk_turns - 1) / chunk_turns);
+}
+
+PackedActions PackedActions::pack(const vector<vector<ActionType>>& actions) {
+    PackedActions res;
+    const int len = actions.front().size();
+    vector<ActionType> acts(n);
+    for(int t = 0; t < len; t++) {
+        for(int k = 0; k < n; k++) {
+            acts[k] = actions[k][t];
+        }
+        res.push_back(acts);
+    }
+    return res;
+}
+
+vector<vector<ActionType>> PackedActions::unpack() const {
+    vector<vector<ActionType>> res(n, vector<ActionType>(turns));
+    for(int t = 0; t < turns; t++) {
+        for(int k = 0; k < n; k++) {
+            res[k][t] = get(t, k);
+        }
+    }
+    return res;
+}
+
+void PackedActions::print() const {
+    for(int k = 0; k < n; k++) {
+        string line;
+        line.reserve(turns);
+        for(int t = 0; t < turns; t++) {
+            const ActionType act = get(t, k);
+            if(act != ActionType::DESTROYED) {
+                line += common::act2char(act);
+            }
+        }
+        cout << line << endl;
+    }
+}
+
+PackedActions PackedActions::read(istream& is) {
+    vector<string> lines(n);
+    size_t len = 0;
+    for(int k = 0; k < n; k++) {
+        getline(is, lines[k]);
+        len = max(len, lines[k].size());
+    }
+    PackedActions res;
+    vector<ActionType> acts(n);
+    for(size_t t = 0; t < len; t++) {
+        for(int k = 0; k < n; k++) {
+            acts[k] = t < lines[k].size() ? common::char2act(lines[k][t]) : ActionType::DESTROYED;
+        }
+        res.push_back(acts);
+    }
+    return res;
+}
+
+#endif
+#include <atomic>
+#include <mutex>
+#include <string>
+
+struct Context {
+    const Input& in;
+    uint64_t seed;      // master seed of this solver
+    string name;        // shown when it improves the incumbent
+    int threads = 1;    // threads the solver may keep busy, its own included
+};
+
+struct Incumbent {
+    atomic<long long> best_score;
+    atomic<bool> cancelled;
+    mutex mtx;
+    vector<vector<ActionType>> best;
+    string owner;
+    Incumbent() : best_score(common::INVALID_SCORE), cancelled(false) {}
+    long long bound() const { return best_score.load(memory_order_acquire); }
+    bool stopped() const { return cancelled.load(memory_order_relaxed); }
+    void cancel() { cancelled.store(true, memory_order_relaxed); }
+    bool publish(const Context& ctx, const PackedActions& actions);
+    bool publish(const Context& ctx, const vector<vector<ActionType>>& actions);
+    vector<vector<ActionType>> get();
+};
+
+bool Incumbent::publish(const Context& ctx, const vector<vector<ActionType>>& actions) {
+    const long long score = common::score(ctx.in, actions);
+    if(score >= bound()) {
+        return false;
+    }
+    lock_guard<mutex> lock(mtx);
+    if(score >= best_score.load(memory_order_relaxed)) {
+        return false;
+    }
+    best = actions;
+    owner = ctx.name;
+    best_score.store(score, memory_order_release);
+    LOG_INFO("incumbent = " << score << " (" << owner << ")");
+    return true;
+}
+
+bool Incumbent::publish(const Context& ctx, const PackedActions& actions) {
+    return publish(ctx, actions.unpack());
+}
+
+vector<vector<ActionType>> Incumbent::get() {
+    lock_guard<mutex> lock(mtx);
+    return best;
+}
+
+#endif
+#include <numeric>
+#include <algorithm>
+#include <set>
+
+extern thread_local Input in;
+
+
+namespace solver_000 {
+
+void copy2res(vector<vector<ActionType>>& res, const vector<ActionType>& actions) {
+    for(int i = 0; i < n; i++) {
+        res[i].push_back(actions[i]);
+    }
+}
+
+vector<vector<ActionType>> solve() {
+
+    vector<vector<ActionType>> res(n);
     
     Terminal term;
     term.init(in);    
@@ -330,16 +1285,16 @@ vector<vector<ActionType>> solve() {
             if(k == 0) {
                 act = ActionType::CATCH;
                 for(int i = 0; i < n; i++) {
-                    assert(term.cranes[i]->i == i);
-                    assert(term.cranes[i]->j == 0);
+                    assert(term.cranes[i].i == i);
+                    assert(term.cranes[i].j == 0);
                 }
             } else if(1 <= k && k <= m1) {
                 act = ActionType::RIGHT;
             } else if(k == m2) {
                 act = ActionType::RELEASE;
                 for(int i = 0; i < n; i++) {
-                    assert(term.cranes[i]->i == i);
-                    assert(term.cranes[i]->j == j);
+                    assert(term.cranes[i].i == i);
+                    assert(term.cranes[i].j == j);
                 }
             } else if(m2+1 <= k && k <= m3) {
                 act = ActionType::LEFT;
@@ -368,13 +1323,11 @@ vector<vector<ActionType>> solve() {
         vector<int> next_c(n, 100);
         set<int> remains;
         for(int i = 0; i < n*n; i++) remains.insert(i);
-        for(int i = 0; i < n; i++) {
-            for(auto p: term.collected_containers[i]) {
-                remains.erase(p->id);
-            }
+        for(int k = 0; k < term.collected_count; k++) {
+            remains.erase(term.collected[k]);
         }
         if(remains.empty()) {
-            cerr << "all containers gone" << endl;
+            LOG_DEBUG("all containers gone");
             break;
         }
         for(int id: remains) {
@@ -386,7 +1339,7 @@ vector<vector<ActionType>> solve() {
         for(int i = 0; i < n; i++) {
             for(int j = 0; j < n-1; j++) {
                 for(int k = 0; k < n; k++) {
-                    if(term.container_pos[i][j] && term.container_pos[i][j]->id == next_c[k]) {
+                    if(term.container_at(i, j) == next_c[k]) {
                         c = next_c[k];
                         break;
                     }
@@ -397,29 +1350,28 @@ vector<vector<ActionType>> solve() {
         }
 
         if(c == -1) {
-            cerr << "cannot found target container (c=-1)" << endl;
+            LOG_WARN("cannot found target container (c=-1)");
             break;
         }
 
-        cerr << "c = " << c << endl;
+        LOG_DEBUG("c = " << c);
 
         auto catch_and_release = [&](int c, int goal_i, int goal_j) -> void {
 
             {
-                const int next_i = term.containers[c]->i;
-                const int next_j = term.containers[c]->j;
-                while(next_i != term.cranes[0]->i) {
+                const auto [next_i, next_j] = term.find_container(c);
+                while(next_i != term.cranes[0].i) {
                     vector<ActionType> actions(n, ActionType::DESTROYED);
-                    const ActionType act = (next_i > term.cranes[0]->i ? ActionType::DOWN : ActionType::UP);
+                    const ActionType act = (next_i > term.cranes[0].i ? ActionType::DOWN : ActionType::UP);
                     actions[0] = act;
                     term.update1();
                     term.update2(actions);
                     copy2res(res, actions);
                     term.update3();
                 }
-                while(next_j != term.cranes[0]->j) {
+                while(next_j != term.cranes[0].j) {
                     vector<ActionType> actions(n, ActionType::DESTROYED);
-                    const ActionType act = (next_j > term.cranes[0]->j ? ActionType::RIGHT : ActionType::LEFT);
+                    const ActionType act = (next_j > term.cranes[0].j ? ActionType::RIGHT : ActionType::LEFT);
                     actions[0] = act;
                     term.update1();
                     term.update2(actions);
@@ -440,18 +1392,18 @@ vector<vector<ActionType>> solve() {
             {
                 const int next_i = goal_i;
                 const int next_j = goal_j;
-                while(next_i != term.cranes[0]->i) {
+                while(next_i != term.cranes[0].i) {
                     vector<ActionType> actions(n, ActionType::DESTROYED);
-                    const ActionType act = (next_i > term.cranes[0]->i ? ActionType::DOWN : ActionType::UP);
+                    const ActionType act = (next_i > term.cranes[0].i ? ActionType::DOWN : ActionType::UP);
                     actions[0] = act;
                     term.update1();
                     term.update2(actions);
                     copy2res(res, actions);
                     term.update3();
                 }
-                while(next_j != term.cranes[0]->j) {
+                while(next_j != term.cranes[0].j) {
                     vector<ActionType> actions(n, ActionType::DESTROYED);
-                    const ActionType act = (next_j > term.cranes[0]->j ? ActionType::RIGHT : ActionType::LEFT);
+                    const ActionType act = (next_j > term.cranes[0].j ? ActionType::RIGHT : ActionType::LEFT);
                     actions[0] = act;
                     term.update1();
                     term.update2(actions);
@@ -470,23 +1422,27 @@ vector<vector<ActionType>> solve() {
             }
         };
 
-        const int catch_i = term.containers[c]->i;
-        const int catch_j = term.containers[c]->j;
-        catch_and_release(c, term.containers[c]->out_i, n-1);
+        const auto [catch_i, catch_j] = term.find_container(c);
+        catch_and_release(c, common::calc_out_i(c), n-1);
 
         for(int i = 0; i < n; i++) {
-            if(term.container_pos[i][0] && !term.container_queue[i].empty()
-                && !term.container_pos[catch_i][catch_j]) {
-                catch_and_release(term.container_pos[i][0]->id, catch_i, catch_j);
+            if(term.has_container(i, 0) && !term.queue_empty(i)
+                && !term.has_container(catch_i, catch_j)) {
+                catch_and_release(term.container_at(i, 0), catch_i, catch_j);
             }
         }
         
-        cerr << "turn_count = " << term.turn_count << endl;
+        LOG_DEBUG("turn_count = " << term.turn_count);
     }
     return res;
 
 }
 
+void solve(const Context& ctx, double, Incumbent& incumbent) {
+    PROFILE_SCOPE(solver_000);
+    incumbent.publish(ctx, solve());
+}
+
 } // namespace solver_000
 
 #endif
@@ -504,9 +1460,27 @@ struct RandGenerator {
     random_device seed_gen;
     mt19937 engine;
     mt19937_64 engine64;
+    uint64_t seed;
     static const int pshift = 1000000000;
     
-    RandGenerator() : engine(seed_gen()), engine64(seed_gen()) {}
+    RandGenerator() {
+        init((uint64_t)seed_gen() << 32 | seed_gen());
+    }
+
+    void init(uint64_t _seed) {
+        seed = _seed;
+        seed_seq seq{(uint32_t)seed, (uint32_t)(seed >> 32)};
+        seed_seq seq64{(uint32_t)(seed >> 32), (uint32_t)seed, 1u};
+        engine.seed(seq);
+        engine64.seed(seq64);
+    }
+    
+    static uint64_t derive(uint64_t master, uint64_t k) {
+        uint64_t z = master + 0x9e3779b97f4a7c15ull * (k + 1);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
     
     int rand(int mod) {
         return engine() % mod;
@@ -523,165 +1497,619 @@ struct RandGenerator {
         return rand(pshift) < p_int;
     }
 
-} ryuka;
+};
+
+thread_local RandGenerator ryuka;
+
+#endif
+#ifndef __PLANNER_HPP__
+#define __PLANNER_HPP__
+
+#ifndef __DISTANCE_HPP__
+#define __DISTANCE_HPP__
+
+
+namespace bitboard {
+    constexpr uint32_t full = (1u << (n*n)) - 1;
+    constexpr uint32_t first_col = 0x108421;
+    constexpr uint32_t last_col = first_col << (n-1);
+    constexpr uint32_t neighbors(uint32_t mask) {
+        return ((mask << n) | (mask >> n) | ((mask & ~last_col) << 1) | ((mask & ~first_col) >> 1)) & full;
+    }
+};
+
+struct DistanceField {
+    int8_t d[n*n];
+    void build(int src, uint32_t obstacle);
+};
+
+void DistanceField::build(int src, uint32_t obstacle) {
+    memset(d, -1, sizeof(d));
+    const uint32_t free = ~obstacle & bitboard::full;
+    uint32_t visited = 1u << src;
+    uint32_t frontier = visited;
+    for(int dist = 0; frontier; dist++) {
+        for(uint32_t mask = frontier; mask; mask &= mask - 1) {
+            d[countr_zero(mask)] = dist;
+        }
+        frontier = bitboard::neighbors(frontier) & free & ~visited;
+        visited |= frontier;
+    }
+}
+
+struct DistanceCache {
+    static constexpr int bucket_bits = 14;
+    struct Slot {
+        uint64_t key;
+        DistanceField field;
+    };
+    vector<Slot> slots;
+    long long hit_counter, miss_counter;
+    DistanceCache() : slots(1 << bucket_bits, Slot{~0ull, {}}), hit_counter(0), miss_counter(0) {}
+    const DistanceField& get(int src, uint32_t obstacle);
+    int dist(int src, int dst, uint32_t obstacle) { return get(src, obstacle).d[dst]; }
+    int dist(int si, int sj, int ti, int tj, uint32_t obstacle) { return dist(si*n+sj, ti*n+tj, obstacle); }
+};
+
+thread_local DistanceCache dist_cache;
+
+const DistanceField& DistanceCache::get(int src, uint32_t obstacle) {
+    const uint64_t key = (uint64_t)obstacle << 5 | src;
+    const int bucket = (key * 0x9e3779b97f4a7c15ull) >> (64 - bucket_bits);
+    Slot& slot = slots[bucket];
+    if(slot.key == key) {
+        hit_counter++;
+    } else {
+        miss_counter++;
+        slot.key = key;
+        slot.field.build(src, obstacle);
+    }
+    return slot.field;
+}
+
+#endif
+#include <numeric>
+#include <algorithm>
+#include <random>
+
+struct Planner {
+    static constexpr int horizon = 16;
+    vector<int> path[n];            // path[k][t]: cell of crane k t turns from now, empty if not planned
+    int goal[n];
+    uint32_t occupied[horizon+1];   // reserved cells at each time step
+    uint32_t busy_after[horizon+1]; // cells reserved at some time step >= t
+    int order[n];
+    int planned_count;
+    uint32_t yield_mask;            // goals of the cranes with one; a crane without a goal keeps off them
+    long long replan_counter;
+    Planner() : planned_count(0), yield_mask(0), replan_counter(0) { fill(goal, goal+n, -1); }
+    void plan(const Terminal&, const int* goals, const bool* pinned, mt19937& engine, bool shuffle = false);
+    int next_cell(int k) const { return path[k].empty() ? -1 : path[k][min(1, (int)path[k].size()-1)]; }
+    int cell_at(int k, int t) const { return path[k][min(t, (int)path[k].size()-1)]; }
+    bool swaps(int from, int to, int t) const;
+    bool valid(int k, uint32_t obstacle) const;
+    bool search(int k, int start, uint32_t obstacle, mt19937& engine);
+    void reserve(int k);
+};
+
+bool Planner::swaps(int from, int to, int t) const {
+    for(int p = 0; p < planned_count; p++) {
+        const int m = order[p];
+        if(cell_at(m, t) == to && cell_at(m, t+1) == from) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Planner::valid(int k, uint32_t obstacle) const {
+    const vector<int>& cells = path[k];
+    if(cells.empty() || (int)cells.size() > horizon+1) {
+        return false;
+    }
+    for(int t = 0; t+1 < (int)cells.size(); t++) {
+        const int to = cells[t+1];
+        if(occupied[t+1] >> to & 1) return false;
+        if(to != cells[t] && ((obstacle >> to & 1) || swaps(cells[t], to, t))) return false;
+    }
+    return !(busy_after[cells.size()-1] >> cells.back() & 1);
+}
+
+bool Planner::search(int k, int start, uint32_t obstacle, mt19937& engine) {
+    replan_counter++;
+    constexpr int di[5] = {0, 1, -1, 0, 0};
+    constexpr int dj[5] = {0, 0, 0, 1, -1};
+    int8_t parent[horizon+1][n*n];
+    const DistanceField* field = goal[k] == -1 ? nullptr : &dist_cache.get(goal[k], obstacle);
+    auto goal_dist = [&](int cell) -> int {
+        if(field == nullptr) return yield_mask >> cell & 1;
+        if(field->d[cell] != -1) return field->d[cell];
+        return 100 + abs(cell / n - goal[k] / n) + abs(cell % n - goal[k] % n);
+    };
+    int dir[5] = {0, 1, 2, 3, 4};
+    shuffle(dir, dir+5, engine);
+    int best_cell = -1, best_t = -1, best_dist = 1 << 30;
+    uint32_t layer = 1u << start;
+    for(int t = 0; layer; t++) {
+        for(uint32_t mask = layer & ~busy_after[t]; mask; mask &= mask - 1) {
+            const int cell = countr_zero(mask);
+            const int d = goal_dist(cell);
+            if(d < best_dist) {
+                best_dist = d;
+                best_cell = cell;
+                best_t = t;
+            }
+        }
+        if(t == horizon || best_dist == 0) {
+            break;
+        }
+        uint32_t next_layer = 0;
+        for(uint32_t mask = layer; mask; mask &= mask - 1) {
+            const int cell = countr_zero(mask);
+            const int i = cell / n;
+            const int j = cell % n;
+            for(int d : dir) {
+                const int ni = i + di[d];
+                const int nj = j + dj[d];
+                if(ni < 0 || nj < 0 || ni >= n || nj >= n) continue;
+                const int to = ni*n + nj;
+                if((next_layer | occupied[t+1]) >> to & 1) continue;
+                if(to != cell && ((obstacle >> to & 1) || swaps(cell, to, t))) continue;
+                next_layer |= 1u << to;
+                parent[t+1][to] = cell;
+            }
+        }
+        layer = next_layer;
+    }
+    if(best_cell == -1) {
+        return false;
+    }
+    path[k].assign(best_t+1, -1);
+    for(int t = best_t, cell = best_cell; t >= 0; t--) {
+        path[k][t] = cell;
+        if(t > 0) cell = parent[t][cell];
+    }
+    return true;
+}
+
+void Planner::reserve(int k) {
+    for(int t = 0; t <= horizon; t++) {
+        occupied[t] |= 1u << cell_at(k, t);
+    }
+    busy_after[horizon] = occupied[horizon];
+    for(int t = horizon-1; t >= 0; t--) {
+        busy_after[t] = occupied[t] | busy_after[t+1];
+    }
+    order[planned_count++] = k;
+}
+
+void Planner::plan(const Terminal& term, const int* goals, const bool* pinned, mt19937& engine, bool shuffle) {
+    bool stationary[n];
+    uint32_t obstacle[n];
+    for(int k = 0; k < n; k++) {
+        const Crane& c = term.cranes[k];
+        const int cur = c.i*n + c.j;
+        stationary[k] = pinned[k];
+        obstacle[k] = 0;
+        if(!c.exist) {
+            path[k].clear();
+            continue;
+        }
+        if(c.crane_type == CraneType::SMALL && c.container != -1) {
+            obstacle[k] = term.container_mask & ~(1u << cur);
+        }
+        if(path[k].size() > 1 && path[k][1] == cur) {
+            path[k].erase(path[k].begin());
+        }
+        if(path[k].empty() || path[k][0] != cur || goal[k] != goals[k] || (goals[k] != -1 && path[k].back() != goals[k])) {
+            path[k].clear();
+        }
+        goal[k] = goals[k];
+    }
+    yield_mask = 0;
+    for(int k = 0; k < n; k++) {
+        if(term.cranes[k].exist && goals[k] != -1) {
+            yield_mask |= 1u << goals[k];
+        }
+    }
+    for(int k = 0; k < n; k++) {
+        if(shuffle || (goals[k] == -1 && !path[k].empty() && (yield_mask >> path[k].back() & 1))) {
+            path[k].clear();
+        }
+    }
+    int noise[n] = {};
+    if(shuffle) {
+        for(int k = 0; k < n; k++) {
+            noise[k] = engine() % n;
+        }
+    }
+    auto rank = [&](int k) -> int {
+        const Crane& c = term.cranes[k];
+        if(stationary[k]) return 0;
+        if(shuffle) return 1 + noise[k];
+        if(c.crane_type == CraneType::LARGE) return 1;
+        if(c.container != -1) return 2;
+        return 3;
+    };
+    while(true) {
+        int ids[n];
+        iota(ids, ids+n, 0);
+        stable_sort(ids, ids+n, [&](int a, int b) { return rank(a) < rank(b); });
+        fill(occupied, occupied+horizon+1, 0);
+        fill(busy_after, busy_after+horizon+1, 0);
+        planned_count = 0;
+        int failed = -1;
+        for(int k : ids) {
+            const Crane& c = term.cranes[k];
+            if(!c.exist) continue;
+            const int cur = c.i*n + c.j;
+            if(stationary[k]) {
+                path[k].assign(1, cur);
+            } else if(!valid(k, obstacle[k]) && !search(k, cur, obstacle[k], engine)) {
+                failed = k;
+                break;
+            }
+            reserve(k);
+        }
+        if(failed == -1) {
+            return;
+        }
+        stationary[failed] = true;
+    }
+}
+
+#endif
+#ifndef __ASSIGNMENT_HPP__
+#define __ASSIGNMENT_HPP__
+
+#include <vector>
+#include <limits>
+#include <cassert>
+
+using namespace std;
+
+vector<int> min_cost_assignment(const vector<vector<long long>>& cost) {
+    const int rows = cost.size();
+    if(rows == 0) {
+        return {};
+    }
+    const int cols = cost[0].size();
+    assert(rows <= cols);
+    constexpr long long inf = numeric_limits<long long>::max() / 4;
+    vector<long long> u(rows+1, 0), v(cols+1, 0);
+    vector<int> match(cols+1, 0), way(cols+1, 0);
+    for(int r = 1; r <= rows; r++) {
+        match[0] = r;
+        int c0 = 0;
+        vector<long long> min_slack(cols+1, inf);
+        vector<bool> used(cols+1, false);
+        do {
+            used[c0] = true;
+            const int r0 = match[c0];
+            long long delta = inf;
+            int c1 = 0;
+            for(int c = 1; c <= cols; c++) {
+                if(used[c]) {
+                    continue;
+                }
+                const long long slack = cost[r0-1][c-1] - u[r0] - v[c];
+                if(slack < min_slack[c]) {
+                    min_slack[c] = slack;
+                    way[c] = c0;
+                }
+                if(min_slack[c] < delta) {
+                    delta = min_slack[c];
+                    c1 = c;
+                }
+            }
+            for(int c = 0; c <= cols; c++) {
+                if(used[c]) {
+                    u[match[c]] += delta;
+                    v[c] -= delta;
+                } else {
+                    min_slack[c] -= delta;
+                }
+            }
+            c0 = c1;
+        } while(match[c0] != 0);
+        do {
+            const int c1 = way[c0];
+            match[c0] = match[c1];
+            c0 = c1;
+        } while(c0 != 0);
+    }
+    vector<int> res(rows, -1);
+    for(int c = 1; c <= cols; c++) {
+        if(match[c] != 0) {
+            res[match[c]-1] = c-1;
+        }
+    }
+    return res;
+}
 
 #endif
 #include <numeric>
 #include <algorithm>
 #include <set>
+#include <atomic>
+#include <thread>
 
-extern Input in;
-extern RandGenerator ryuka;
+extern thread_local Input in;
+extern thread_local RandGenerator ryuka;
+extern Timer toki;
 
 namespace sovler_001 {
 
+constexpr int stuck_turns = 3;
+constexpr int stall_turns = 8;
+constexpr int restart_count = 128;
+constexpr int task_noise = 2;
+constexpr int large_job_bonus = 20;
+
+struct Lookahead {
+    int width, horizon;
+};
+constexpr Lookahead max_lookahead = {2, 60};
+constexpr double lookahead_budget = 1.0;
+
+Lookahead lookahead_for(double remaining) {
+    const double x = clamp(remaining / lookahead_budget, 0.0, 1.0);
+    return Lookahead{(int)lround(1 + (max_lookahead.width - 1) * x), (int)lround(max_lookahead.horizon * x)};
+}
+
 struct CR_task {
     int catch_i, catch_j;
     int release_i, release_j;
     bool large_job;
+    CR_task() = default;
     CR_task(int catch_i, int catch_j, int release_i, int release_j, bool large_job) : 
         catch_i(catch_i), catch_j(catch_j), release_i(release_i), release_j(release_j), large_job(large_job) {}
 };
 
-void copy2res(vector<vector<ActionType>>& res, const vector<ActionType>& actions) {
-    for(int i = 0; i < n; i++) {
-        res[i].push_back(actions[i]);
+struct TaskRegistry {
+    static constexpr int capacity = 64;
+    static constexpr int nil = -1;
+    CR_task tasks[capacity];
+    int8_t prev[capacity], next[capacity];
+    int8_t catch_owner[2][n*n];         // [large_job][cell]: そのマスをつかむタスク、なければ nil
+    uint8_t release_count[2][n*n];
+    uint32_t catch_mask[2], release_mask[2];
+    uint64_t free_slots;
+    int head, tail, count;
+
+    struct iterator {
+        const TaskRegistry* registry;
+        int t;
+        int operator*() const { return t; }
+        iterator& operator++() { t = registry->next[t]; return *this; }
+        bool operator!=(const iterator& other) const { return t != other.t; }
+    };
+
+    TaskRegistry() { clear(); }
+    void clear();
+    int size() const { return count; }
+    const CR_task& operator[](int t) const { return tasks[t]; }
+    iterator begin() const { return iterator{this, head}; }
+    iterator end() const { return iterator{this, nil}; }
+    int insert(const CR_task& cr);
+    void erase(int t);
+    int find_catch(int cell, bool large_job) const { return catch_owner[large_job][cell]; }
+    bool reserved(int cell, bool skip_large_job) const {
+        uint32_t mask = catch_mask[0] | release_mask[0];
+        if(!skip_large_job) {
+            mask |= catch_mask[1] | release_mask[1];
+        }
+        return mask >> cell & 1;
+    }
+};
+
+void TaskRegistry::clear() {
+    memset(catch_owner, nil, sizeof(catch_owner));
+    memset(release_count, 0, sizeof(release_count));
+    catch_mask[0] = catch_mask[1] = release_mask[0] = release_mask[1] = 0;
+    free_slots = ~0ull;
+    head = tail = nil;
+    count = 0;
+}
+
+int TaskRegistry::insert(const CR_task& cr) {
+    assert(free_slots != 0);
+    const int t = countr_zero(free_slots);
+    free_slots &= free_slots - 1;
+    tasks[t] = cr;
+    prev[t] = tail;
+    next[t] = nil;
+    if(tail == nil) {
+        head = t;
+    } else {
+        next[tail] = t;
+    }
+    tail = t;
+    count++;
+    const int c = cr.catch_i*n + cr.catch_j;
+    const int r = cr.release_i*n + cr.release_j;
+    assert(catch_owner[cr.large_job][c] == nil);
+    catch_owner[cr.large_job][c] = t;
+    catch_mask[cr.large_job] |= 1u << c;
+    release_count[cr.large_job][r]++;
+    release_mask[cr.large_job] |= 1u << r;
+    return t;
+}
+
+void TaskRegistry::erase(int t) {
+    const CR_task& cr = tasks[t];
+    const int c = cr.catch_i*n + cr.catch_j;
+    const int r = cr.release_i*n + cr.release_j;
+    catch_owner[cr.large_job][c] = nil;
+    catch_mask[cr.large_job] &= ~(1u << c);
+    if(--release_count[cr.large_job][r] == 0) {
+        release_mask[cr.large_job] &= ~(1u << r);
+    }
+    if(prev[t] == nil) {
+        head = next[t];
+    } else {
+        next[prev[t]] = next[t];
     }
+    if(next[t] == nil) {
+        tail = prev[t];
+    } else {
+        prev[next[t]] = prev[t];
+    }
+    free_slots |= 1ull << t;
+    count--;
 }
 
-ActionType get_next_action(int i, const vector<vector<shared_ptr<Crane>>>& next_crane_pos, const Terminal& term, const vector<vector<ActionType>>& res) {
-    shared_ptr<Crane> crane = term.cranes[i];
+ActionType get_next_action(int i, int next_cell, int stay_count, uint32_t reserved, const Terminal& term, const PackedActions& res) {
+    PROFILE_SCOPE(get_next_action);
+    const Crane* crane = &term.cranes[i];
     if(!crane->exist) {
         return ActionType::DESTROYED;
     }
-    auto random_walk = [&]() -> ActionType {
-        constexpr int di[4] = {1, -1,  0, 0};
-        constexpr int dj[4] = {0,  0, -1, 1};
-        vector<int> k_idx = {0, 1, 2, 3};
-        shuffle(k_idx.begin(), k_idx.end(), ryuka.engine);
-        constexpr ActionType act_types[4] = {ActionType::DOWN, ActionType::UP, ActionType::LEFT, ActionType::RIGHT};
-        for(int k : k_idx) {
-            const int next_i = crane->i + di[k];
-            const int next_j = crane->j + dj[k];
-            if(next_i < 0 || next_j < 0 || next_i >= n || next_j >= n) continue;
-            if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                return act_types[k];
-            }
-        }
-        return ActionType::BOMB;
-    };       
+    const int cur = crane->i*n + crane->j;
+    auto move_to_next = [&]() -> ActionType {
+        if(next_cell == cur + n) return ActionType::DOWN;
+        if(next_cell == cur - n) return ActionType::UP;
+        if(next_cell == cur + 1) return ActionType::RIGHT;
+        if(next_cell == cur - 1) return ActionType::LEFT;
+        return ActionType::WAIT;
+    };
     if(crane->status == CraneStatus::FREE) {
-        assert(!crane->container);
-        /*
-        if(!next_crane_pos[crane->i][crane->j]) {
-            return ActionType::WAIT;
-        }
-        */
-        int container_count = 0;
-        for(int i = 0; i < n; i++) {
-            for(int j = 0; j < n; j++) {
-                if(term.container_pos[i][j]) {
-                    container_count++;
-                }
-            }
-        }
+        assert(crane->container == -1);
+        const int container_count = popcount(term.container_mask);
         int crane_count = 0;
         for(int i = 0; i < n; i++) {
-            if(term.cranes[i]->exist) {
+            if(term.cranes[i].exist) {
                 crane_count++;
             }
         }
         if(container_count < crane_count && i != 0) {
             return ActionType::BOMB;
         }
-        return random_walk();
+        return move_to_next();
     }
     else if(crane->status == CraneStatus::PRE_CATCH) {
-        const int di = crane->catch_i - crane->i;
-        const int dj = crane->catch_j - crane->j;
-        const int ord = ryuka.rand(2);
-        for(int k = 0; k < 2; k++) {
-            if(di != 0 && k == ord) {
-                const int next_i = crane->i + (di > 0 ? 1 : -1);
-                const int next_j = crane->j;
-                if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                    return (di > 0 ? ActionType::DOWN : ActionType::UP);
-                }
-            }
-            if(dj != 0 && k != ord) {
-                const int next_i = crane->i;
-                const int next_j = crane->j + (dj > 0 ? 1 : -1);
-                if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                    return (dj > 0 ? ActionType::RIGHT : ActionType::LEFT);
-                }
-            }
-        }
-        if(di == 0 && dj == 0) {
+        if(crane->i == crane->catch_i && crane->j == crane->catch_j && next_cell == cur) {
             return ActionType::CATCH;
         }
-        if(crane->crane_type == CraneType::SMALL) {
-            return random_walk();
-        }
-        return ActionType::WAIT;
+        return move_to_next();
     } 
     else if(crane->status == CraneStatus::CATCH_NOW) {
         assert(crane->i == crane->catch_i && crane->j == crane->catch_j);
-        if(!term.container_pos[crane->i][crane->j]) {
-            cerr << crane->i << ", " << crane->j << endl;
-            common::print(res);
+        if(!term.has_container(crane->i, crane->j)) {
+            LOG_ERROR("no container to catch at " << (int)crane->i << ", " << (int)crane->j);
+            res.print();
         }
-        assert(term.container_pos[crane->i][crane->j]);
-        assert(!crane->container);
+        assert(term.has_container(crane->i, crane->j));
+        assert(crane->container == -1);
         return ActionType::CATCH;
     }
     else if(crane->status == CraneStatus::PRE_RELEASE) {
-        const int di = crane->release_i - crane->i;
-        const int dj = crane->release_j - crane->j;
-        const int ord = ryuka.rand(2);
-        for(int k = 0; k < 2; k++) {
-            if(di != 0 && k == ord) {
-                const int next_i = crane->i + (di > 0 ? 1 : -1);
-                const int next_j = crane->j;
-                if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                    return (di > 0 ? ActionType::DOWN : ActionType::UP);
-                }
-            }
-            if(dj != 0 && k != ord) {
-                const int next_i = crane->i;
-                const int next_j = crane->j + (dj > 0 ? 1 : -1);
-                if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                    return (dj > 0 ? ActionType::RIGHT : ActionType::LEFT);
-                }
-            }
-        }
-        if(di == 0 && dj == 0) {
+        if(crane->i == crane->release_i && crane->j == crane->release_j && next_cell == cur) {
             return ActionType::RELEASE;
         }
-        if(crane->crane_type == CraneType::SMALL) {
-            if(crane->container) {
-                return ActionType::RELEASE;
-            }
-            return random_walk();
+        if(crane->crane_type == CraneType::SMALL && next_cell == cur && stay_count >= stuck_turns
+            && crane->j != n-1 && !term.has_container(crane->i, crane->j) && !(reserved >> cur & 1)) {
+            return ActionType::RELEASE;
         }
-        return ActionType::WAIT;
+        return move_to_next();
     }
     else if(crane->status == CraneStatus::RELEASE_NOW) {
         assert(crane->i == crane->release_i && crane->j == crane->release_j);
-        assert(crane->container);
+        assert(crane->container != -1);
         return ActionType::RELEASE;
     }
 
-    cerr << "get_next_action: failed to find next action" << endl;
+    LOG_WARN("get_next_action: failed to find next action");
     return ActionType::WAIT;
 }
 
 
-vector<vector<ActionType>> solve() {
+long long evaluate(const Terminal& term) {
+    long long delivered = 0, wrong = 0, inversions = 0;
+    bool gone[n*n] = {};
+    for(int a = 0; a < term.collected_count; a++) {
+        gone[term.collected[a]] = true;
+        if(common::calc_out_i(term.collected[a]) != term.collected_row[a]) {
+            wrong++;
+        } else {
+            delivered++;
+        }
+        for(int b = a+1; b < term.collected_count; b++) {
+            if(term.collected_row[a] == term.collected_row[b] && term.collected[a] > term.collected[b]) {
+                inversions++;
+            }
+        }
+    }
+    long long blocking = 0;
+    for(int r = 0; r < n; r++) {
+        int c = -1;
+        for(int id = r*n; id < (r+1)*n; id++) {
+            if(!gone[id]) {
+                c = id;
+                break;
+            }
+        }
+        if(c == -1) {
+            continue;
+        }
+        const auto [ci, cj] = term.find_container(c);
+        if(ci != -1) {
+            blocking += abs(ci - r) + (n-1 - cj);
+            continue;
+        }
+        for(int q = 0; q < n; q++) {
+            for(int p = term.queue_head[q]; p < n; p++) {
+                if(term.queue[q][p] == c) {
+                    blocking += 4 * (p - term.queue_head[q] + 1) + abs(q - r) + (n-1);
+                }
+            }
+        }
+    }
+    return 100*delivered - 10000*wrong - 100*inversions - 5*blocking;
+}
 
-    vector<vector<ActionType>> res(n);
-    
+struct Dispatcher {
     Terminal term;
-    term.init(in);    
+    TaskRegistry cr_tasks;
+    uint32_t crane_reserved;            // クレーンが受け持っているタスクのつかむ・置くマス
+    Planner planner;
+    int stay_count[n];
+    int stall_count;                    // だれもつかむ・置くをしていないターン数
+    PackedActions res;
+    bool verbose;
+    Lookahead lookahead;
+    void init(const Input&, bool verbose);
+    bool finished() const { return term.remaining_containers() == 0; }
+    bool stalled() const { return stall_count > 0 && stall_count % stall_turns == 0; }
+    void erase_cr_tasks(int catch_i, int catch_j);
+    bool check_conflict(int i, int j, bool skip_large_job = false) const;
+    void update_crane_reserved();
+    uint32_t reserved_cells() const;
+    void update_cr_tasks(const vector<int>& next_c);
+    vector<int> next_containers() const;
+    bool begin_turn();
+    void unstick();
+    int task_cost(int i, int t) const;
+    int best_task(int i, mt19937* engine = nullptr) const;
+    int assignment_cost(int i, int t) const;
+    long long rollout(int i, int t) const;
+    void assign_by_lookahead();
+    void assign(int i, int t);
+    void assign_free_cranes(mt19937* engine = nullptr);
+    void plan_paths(mt19937& engine);
+    void end_turn(mt19937& engine);
+};
+
+void Dispatcher::init(const Input& in, bool _verbose) {
+    verbose = _verbose;
+    lookahead = Lookahead{0, 0};
+    term.init(in);
+    cr_tasks.clear();
+    crane_reserved = 0;
+    planner = Planner();
+    fill(stay_count, stay_count+n, 0);
+    stall_count = 0;
+    res = PackedActions();
 
 
     for (int j = 3; j >= 1; j--) {
@@ -695,23 +2123,23 @@ vector<vector<ActionType>> solve() {
             if(k == 0) {
                 act = ActionType::CATCH;
                 for(int i = 0; i < n; i++) {
-                    assert(term.cranes[i]->i == i);
-                    assert(term.cranes[i]->j == 0);
+                    assert(term.cranes[i].i == i);
+                    assert(term.cranes[i].j == 0);
                 }
             } else if(1 <= k && k <= m1) {
                 act = ActionType::RIGHT;
             } else if(k == m2) {
                 act = ActionType::RELEASE;
                 for(int i = 0; i < n; i++) {
-                    assert(term.cranes[i]->i == i);
-                    assert(term.cranes[i]->j == j);
+                    assert(term.cranes[i].i == i);
+                    assert(term.cranes[i].j == j);
                 }
             } else if(m2+1 <= k && k <= m3) {
                 act = ActionType::LEFT;
             }
 
             vector<ActionType> actions(n, act);
-            copy2res(res, actions);
+            res.push_back(actions);
             term.update2(actions);            
             term.update3();
         }
@@ -724,242 +2152,1475 @@ vector<vector<ActionType>> solve() {
         for(int i = 1; i < n; i++) {
             actions[i] = ActionType::BOMB;
         }
-        copy2res(res, actions);
+        res.push_back(actions);
         term.update2(actions);
         term.update3();
     }
     */
+}
 
-    vector<CR_task> cr_tasks;
-    auto erase_cr_tasks = [&](int catch_i, int catch_j) -> void {
-        vector<CR_task> new_cr_tasks;
-        for(const CR_task cr: cr_tasks) {
-            if(cr.catch_i == catch_i && cr.catch_j == catch_j) {
-                ;
-            } else {
-                new_cr_tasks.push_back(cr);
-            }
+void Dispatcher::erase_cr_tasks(int catch_i, int catch_j) {
+    for(const bool large_job : {false, true}) {
+        const int t = cr_tasks.find_catch(catch_i*n + catch_j, large_job);
+        if(t != TaskRegistry::nil) {
+            cr_tasks.erase(t);
         }
-        swap(new_cr_tasks, cr_tasks);
-    };
+    }
+}
 
-    auto check_conflict = [&](int i, int j, bool skip_large_job = false) -> bool {
-        for(const CR_task cr : cr_tasks) {
-            if(skip_large_job && cr.large_job) {
-                continue;
-            }
-            if(cr.catch_i == i && cr.catch_j == j) {
-                return false;
+bool Dispatcher::check_conflict(int i, int j, bool skip_large_job) const {
+    const int cell = i*n + j;
+    return !cr_tasks.reserved(cell, skip_large_job) && !(crane_reserved >> cell & 1);
+}
+
+void Dispatcher::update_crane_reserved() {
+    crane_reserved = 0;
+    for(const Crane& c : term.cranes) {
+        if(c.status != CraneStatus::FREE && c.exist) {
+            if( c.status == CraneStatus::PRE_CATCH || c.status == CraneStatus::CATCH_NOW) {
+                crane_reserved |= 1u << (c.catch_i*n + c.catch_j);
             }
-            if(cr.release_i == i && cr.release_j == j) {
-                return false;
+            crane_reserved |= 1u << (c.release_i*n + c.release_j);
+        }
+    }
+}
+
+uint32_t Dispatcher::reserved_cells() const {
+    return cr_tasks.catch_mask[0] | cr_tasks.catch_mask[1] | cr_tasks.release_mask[0] | cr_tasks.release_mask[1] | crane_reserved;
+}
+
+void Dispatcher::update_cr_tasks(const vector<int>& next_c) {
+    PROFILE_SCOPE(update_cr_tasks);
+    update_crane_reserved();
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n-1; j++) {
+            for(int r = 0; r < n; r++) {
+                if(check_conflict(i, j) && term.container_at(i, j) == next_c[r]) {
+                    cr_tasks.insert(CR_task(i, j, common::calc_out_i(next_c[r]), n-1, true));
+                    break;
+                }   
             }
         }
-        for(const shared_ptr<Crane> c : term.cranes) {
-            if(c->status != CraneStatus::FREE && c->exist) {
-                if( c->status == CraneStatus::PRE_CATCH || c->status == CraneStatus::CATCH_NOW) {
-                    if(c->catch_i == i && c->catch_j == j) {
-                        return false;
+    }
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n-1; j++) {
+            if(check_conflict(i, j) && !term.has_container(i, j) && !term.has_crane(i, j)) {
+                constexpr int di[2] = {1, -1};
+                constexpr int dj[2] = {0,  0};
+                for(int k = 0; k < 2; k++) {
+                    const int adj_i = i + di[k];
+                    const int adj_j = j + dj[k];
+                    auto is_closer_than_cur = [&](int out_i, int cur_i, int next_i) -> bool {
+                        const int diff_cur = abs(out_i - cur_i);
+                        const int diff_next = abs(out_i - next_i);
+                        return diff_next < diff_cur;
+                    };
+                    if( adj_i >= 0 && adj_j >= 0 && adj_i < n && adj_j < n &&
+                        term.has_container(adj_i, adj_j) &&
+                        check_conflict(adj_i, adj_j, true) &&
+                        (is_closer_than_cur(common::calc_out_i(term.container_at(adj_i, adj_j)), adj_i, i) || !term.queue_empty(i))) 
+                    {
+                        cr_tasks.insert(CR_task(adj_i, adj_j, i, j, false));
+                        break;
                     }
                 }
-                if(c->release_i == i && c->release_j == j) {
-                    return false;
+            }
+        }
+    }
+    for(int i = 0; i < n; i++) {
+        for(int j = 1; j < n-1; j++) {
+            if(check_conflict(i, j) && !term.has_crane(i, j) && !term.has_container(i, j)) {
+                const int adj_i = i;
+                const int adj_j = j - 1;
+                if( adj_i >= 0 && adj_j >= 0 && adj_i < n && adj_j < n &&
+                    term.has_container(adj_i, adj_j) &&
+                    check_conflict(adj_i, adj_j, true))
+                {
+                    cr_tasks.insert(CR_task(adj_i, adj_j, i, j, false));
+                    break;
                 }
             }
         }
-        return true;
-    };
-
-    while(term.turn_count < MAX_TURN) {
-
-        term.watch();
+    }
+}
 
-        vector<int> next_c(n, 100);
-        set<int> remains;
-        for(int i = 0; i < n*n; i++) remains.insert(i);
+vector<int> Dispatcher::next_containers() const {
+    vector<int> next_c(n, 100);
+    bool gone[n*n] = {};
+    for(int k = 0; k < term.collected_count; k++) {
+        gone[term.collected[k]] = true;
+    }
+    for(int id = 0; id < n*n; id++) {
+        if(!gone[id]) {
+            int i = common::calc_out_i(id);
+            next_c[i] = min(next_c[i], id);
+        }
+    }
+    return next_c;
+}
+
+bool Dispatcher::begin_turn() {
+
+    if(verbose) LOG_TRACE(term);
+
+    if(finished()) {
+        if(verbose) LOG_DEBUG("all containers gone");
+        return false;
+    }
+    const vector<int> next_c = next_containers();
+
+    term.update1();
+    if(stalled()) {
+        unstick();
+    }
+    update_cr_tasks(next_c);
+    if(verbose) {
+        LOG_DEBUG("cr_tasks.size() = " << cr_tasks.size());
+        for(const int t : cr_tasks) {
+            const CR_task& cr = cr_tasks[t];
+            LOG_DEBUG(cr.catch_i << "," << cr.catch_j << "->" << cr.release_i << "," << cr.release_j);
+        }
         for(int i = 0; i < n; i++) {
-            for(auto p: term.collected_containers[i]) {
-                remains.erase(p->id);
+            LOG_DEBUG("crane #" << i << ": " << (int)term.cranes[i].status);
+        }
+    }
+    return true;
+}
+
+void Dispatcher::unstick() {
+    for(Crane& c : term.cranes) {
+        if(c.exist && c.container == -1 && c.status == CraneStatus::PRE_CATCH) {
+            c.status = CraneStatus::FREE;
+        }
+    }
+    update_crane_reserved();
+    for(int i = 0; i < n; i++) {
+        if(term.queue_empty(i) || !term.has_container(i, 0) || !check_conflict(i, 0)) {
+            continue;
+        }
+        int best = -1, best_dist = 1 << 30;
+        for(int cell = 0; cell < n*n; cell++) {
+            const int ci = cell / n;
+            const int cj = cell % n;
+            if(cj == n-1 || (cj == 0 && !term.queue_empty(ci)) || term.has_container(ci, cj) || term.has_crane(ci, cj) || !check_conflict(ci, cj)) {
+                continue;
+            }
+            const int dist = abs(ci - i) + cj;
+            if(dist < best_dist) {
+                best_dist = dist;
+                best = cell;
             }
         }
-        if(remains.empty()) {
-            cerr << "all containers gone" << endl;
+        if(best != -1) {
+            cr_tasks.insert(CR_task(i, 0, best / n, best % n, false));
+        }
+    }
+}
+
+int Dispatcher::task_cost(int i, int t) const {
+    if(!term.has_container(cr_tasks[t].catch_i, cr_tasks[t].catch_j)) {
+        return -1;
+    }
+    if(i != 0 && cr_tasks[t].large_job) {
+        return -1;
+    }
+    if(term.has_container(cr_tasks[t].release_i, cr_tasks[t].release_j)) {
+        return -1;
+    }
+    int dist =  abs(term.cranes[i].i - cr_tasks[t].catch_i) +
+                abs(term.cranes[i].j - cr_tasks[t].catch_j);
+    if(term.cranes[i].prev_container_id == term.container_at(cr_tasks[t].catch_i, cr_tasks[t].catch_j)) {
+        if(term.cranes[i].crane_type == CraneType::LARGE) {
+            dist += 1000;
+        } else {
+            dist += 1000000;
+        }
+    }
+    return dist;
+}
+
+int Dispatcher::best_task(int i, mt19937* engine) const {
+    int best_task_id = -1;
+    int min_dist = 100000;
+    for(const int t : cr_tasks) {
+        int dist = task_cost(i, t);
+        if(dist == -1) {
+            continue;
+        }
+        if(engine) {
+            dist += (*engine)() % (task_noise + 1);
+        }
+        if(min_dist > dist) {
+            min_dist = dist;
+            best_task_id = t;
+        }
+    }
+    return best_task_id;
+}
+
+void Dispatcher::assign(int i, int t) {
+    const CR_task cr = cr_tasks[t];
+    if(verbose) LOG_DEBUG("cr " << i << ":" << cr.catch_i << "," << cr.catch_j << "->" << cr.release_i << "," << cr.release_j);
+    term.cranes[i].set_catch_and_release(cr.catch_i, cr.catch_j, cr.release_i, cr.release_j);
+    erase_cr_tasks(cr.catch_i, cr.catch_j);
+}
+
+int Dispatcher::assignment_cost(int i, int t) const {
+    const int cost = task_cost(i, t);
+    if(cost == -1 || cost >= 100000) {
+        return -1;
+    }
+    const CR_task& cr = cr_tasks[t];
+    const int from = cr.catch_i*n + cr.catch_j;
+    const int to = cr.release_i*n + cr.release_j;
+    int carry = abs(cr.catch_i - cr.release_i) + abs(cr.catch_j - cr.release_j);
+    if(term.cranes[i].crane_type == CraneType::SMALL) {
+        carry = dist_cache.dist(from, to, term.container_mask & ~(1u << from));
+        if(carry == -1) {
+            return -1;
+        }
+    }
+    return cost + carry - (cr.large_job ? large_job_bonus : 0);
+}
+
+long long Dispatcher::rollout(int i, int t) const {
+    Dispatcher d = *this;
+    d.lookahead = Lookahead{0, 0};
+    d.verbose = false;
+    d.assign(i, t);
+    d.assign_free_cranes();
+    mt19937 engine(term.turn_count);
+    d.end_turn(engine);
+    int h = 1;
+    for(; h < lookahead.horizon; h++) {
+        if(!d.begin_turn()) {
             break;
         }
-        for(int id: remains) {
-            int i = common::calc_out_i(id);
-            next_c[i] = min(next_c[i], id);
+        d.assign_free_cranes();
+        d.end_turn(engine);
+    }
+    return evaluate(d.term) + (d.finished() ? 100LL * (lookahead.horizon - h) : 0);
+}
+
+void Dispatcher::assign_by_lookahead() {
+    PROFILE_SCOPE(lookahead);
+    for(int i = 0; i < n; i++) {
+        if(!term.cranes[i].exist || term.cranes[i].status != CraneStatus::FREE) {
+            continue;
         }
-        
-        auto update_cr_tasks = [&]() -> void {
-            for(int i = 0; i < n; i++) {
-                for(int j = 0; j < n-1; j++) {
-                    for(int r = 0; r < n; r++) {
-                        if(check_conflict(i, j) && term.container_pos[i][j] && term.container_pos[i][j]->id == next_c[r]) {
-                            cr_tasks.push_back(CR_task(i, j, term.container_pos[i][j]->out_i, n-1, true));
-                            break;
-                        }   
-                    }
+        vector<pair<int, int>> candidates;
+        for(const int t : cr_tasks) {
+            const int cost = assignment_cost(i, t);
+            if(cost != -1) {
+                candidates.emplace_back(cost, t);
+            }
+        }
+        if(candidates.empty()) {
+            continue;
+        }
+        const int k = min((int)candidates.size(), lookahead.width);
+        partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+        if(k >= 2) {
+            int best = candidates[0].second;
+            long long best_value = LLONG_MIN;
+            for(int c = 0; c < k; c++) {
+                const long long value = rollout(i, candidates[c].second);
+                if(value > best_value) {
+                    best_value = value;
+                    best = candidates[c].second;
                 }
             }
-            for(int i = 0; i < n; i++) {
-                for(int j = 0; j < n-1; j++) {
-                    if(check_conflict(i, j) && !term.container_pos[i][j] && !term.crane_pos[i][j]) {
-                        constexpr int di[2] = {1, -1};
-                        constexpr int dj[2] = {0,  0};
-                        for(int k = 0; k < 2; k++) {
-                            const int adj_i = i + di[k];
-                            const int adj_j = j + dj[k];
-                            auto is_closer_than_cur = [&](int out_i, int cur_i, int next_i) -> bool {
-                                const int diff_cur = abs(out_i - cur_i);
-                                const int diff_next = abs(out_i - next_i);
-                                return diff_next < diff_cur;
-                            };
-                            if( adj_i >= 0 && adj_j >= 0 && adj_i < n && adj_j < n &&
-                                term.container_pos[adj_i][adj_j] &&
-                                check_conflict(adj_i, adj_j, true) &&
-                                (is_closer_than_cur(term.container_pos[adj_i][adj_j]->out_i, adj_i, i) || !term.container_queue[i].empty())) 
-                            {
-                                cr_tasks.push_back(CR_task(adj_i, adj_j, i, j, false));
-                                break;
-                            }
-                        }
-                    }
+            assign(i, best);
+        }
+        return;
+    }
+}
+
+void Dispatcher::assign_free_cranes(mt19937* engine) {
+    if(lookahead.width > 1 && lookahead.horizon > 0) {
+        assign_by_lookahead();
+    }
+    PROFILE_SCOPE(assign_tasks);
+    constexpr long long idle_cost = 1000000;
+    constexpr long long infeasible = 1000000000;
+    bool retry = true;
+    while(retry) {
+        retry = false;
+        vector<int> free_cranes, handles;
+        for(int i = 0; i < n; i++) {
+            if(term.cranes[i].exist && term.cranes[i].status == CraneStatus::FREE) {
+                free_cranes.push_back(i);
+            }
+        }
+        for(const int t : cr_tasks) {
+            handles.push_back(t);
+        }
+        if(free_cranes.empty() || handles.empty()) {
+            return;
+        }
+        const int rows = free_cranes.size();
+        const int tasks = handles.size();
+        vector<vector<long long>> cost(rows, vector<long long>(tasks + rows, idle_cost));
+        for(int r = 0; r < rows; r++) {
+            for(int c = 0; c < tasks; c++) {
+                const int d = assignment_cost(free_cranes[r], handles[c]);
+                cost[r][c] = (d == -1 ? infeasible : d + (engine ? (*engine)() % (task_noise + 1) : 0));
+            }
+        }
+        const vector<int> match = min_cost_assignment(cost);
+        for(int r = 0; r < rows; r++) {
+            const int c = match[r];
+            if(c >= tasks || cost[r][c] >= infeasible) {
+                continue;
+            }
+            const int t = handles[c];
+            const CR_task& cr = cr_tasks[t];
+            if(cr_tasks.find_catch(cr.catch_i*n + cr.catch_j, cr.large_job) != t) {
+                retry = true;
+                continue;
+            }
+            assign(free_cranes[r], t);
+        }
+    }
+}
+
+void Dispatcher::plan_paths(mt19937& engine) {
+    PROFILE_SCOPE(plan_paths);
+    int goals[n];
+    bool pinned[n];
+    for(int i = 0; i < n; i++) {
+        const Crane& c = term.cranes[i];
+        const int cur = c.i*n + c.j;
+        goals[i] = -1;
+        pinned[i] = false;
+        if(c.status == CraneStatus::PRE_CATCH || c.status == CraneStatus::CATCH_NOW) {
+            goals[i] = c.catch_i*n + c.catch_j;
+        } else if(c.status == CraneStatus::PRE_RELEASE || c.status == CraneStatus::RELEASE_NOW) {
+            goals[i] = c.release_i*n + c.release_j;
+        }
+        pinned[i] = (goals[i] == cur);
+    }
+    planner.plan(term, goals, pinned, engine, stalled());
+}
+
+void Dispatcher::end_turn(mt19937& engine) {
+    plan_paths(engine);
+
+    update_crane_reserved();
+    const uint32_t reserved = reserved_cells();
+    vector<ActionType> actions(n, ActionType::WAIT);
+    for(int i = 0; i < n; i++) {
+        actions[i] = get_next_action(i, planner.next_cell(i), stay_count[i], reserved, term, res);
+        const auto [di, dj] = common::act2move(actions[i]);
+        stay_count[i] = (di == 0 && dj == 0 ? stay_count[i] + 1 : 0);
+    } 
+    const bool progress = any_of(actions.begin(), actions.end(), [](ActionType act) {
+        return act == ActionType::CATCH || act == ActionType::RELEASE;
+    });
+    stall_count = progress ? 0 : stall_count + 1;
+
+    term.update2(actions);
+    term.update3();
+    res.push_back(actions);
+
+    if(verbose) LOG_DEBUG("turn_count (solver_001) = " << term.turn_count);
+}
+
+vector<vector<ActionType>> solve() {
+
+    Dispatcher dispatcher;
+    dispatcher.init(in, true);
+
+    while(dispatcher.term.turn_count < MAX_TURN) {
+        if(!dispatcher.begin_turn()) {
+            break;
+        }
+        dispatcher.assign_free_cranes();
+        dispatcher.end_turn(ryuka.engine);
+    }
+    return dispatcher.res.unpack();
+
+}
+
+PackedActions run_restart(uint64_t master_seed, int r, const Incumbent& incumbent, double lookahead_deadline = 0) {
+    mt19937 engine(RandGenerator::derive(master_seed, r));
+    Dispatcher dispatcher;
+    dispatcher.init(in, false);
+    while(dispatcher.term.turn_count < MAX_TURN) {
+        if(dispatcher.res.size() >= incumbent.bound() || incumbent.stopped()) {
+            break;
+        }
+        if(!dispatcher.begin_turn()) {
+            break;
+        }
+        if(lookahead_deadline > 0) {
+            dispatcher.lookahead = lookahead_for(lookahead_deadline - toki.elapsed());
+        }
+        dispatcher.assign_free_cranes(r == 0 ? nullptr : &engine);
+        dispatcher.end_turn(engine);
+    }
+    return dispatcher.res;
+}
+
+vector<vector<ActionType>> solve_restarts(const Context& ctx, int restarts, double deadline, Incumbent& incumbent) {
+    vector<long long> scores(restarts, common::INVALID_SCORE);
+    vector<PackedActions> results(restarts);
+    atomic<int> next_restart(0);
+    const int threads = max(1, ctx.threads);
+    vector<long long> extra_scores(threads, common::INVALID_SCORE);
+    vector<PackedActions> extra_results(threads);
+    auto worker = [&](int tid) -> void {
+        in = ctx.in;
+        while(toki.elapsed() < deadline && !incumbent.stopped()) {
+            const int r = next_restart++;
+            PROFILE_COUNT(restarts);
+            PackedActions result;
+            long long score;
+            if(r < restarts) {
+                result = results[r] = run_restart(ctx.seed, r, incumbent);
+                score = scores[r] = common::score(in, result.unpack());
+            } else {
+                result = run_restart(ctx.seed, r, incumbent, deadline);
+                score = common::score(in, result.unpack());
+                if(score < extra_scores[tid]) {
+                    extra_scores[tid] = score;
+                    extra_results[tid] = result;
                 }
             }
-            for(int i = 0; i < n; i++) {
-                for(int j = 1; j < n-1; j++) {
-                    if(check_conflict(i, j) && !term.crane_pos[i][j] && !term.container_pos[i][j]) {
-                        const int adj_i = i;
-                        const int adj_j = j - 1;
-                        if( adj_i >= 0 && adj_j >= 0 && adj_i < n && adj_j < n &&
-                            term.container_pos[adj_i][adj_j] &&
-                            check_conflict(adj_i, adj_j, true))
-                        {
-                            cr_tasks.push_back(CR_task(adj_i, adj_j, i, j, false));
-                            break;
-                        }
+            if(score < incumbent.bound()) {
+                incumbent.publish(ctx, result);
+            }
+        }
+    };
+    vector<thread> pool;
+    for(int t = 0; t < threads; t++) {
+        pool.emplace_back(worker, t);
+    }
+    for(thread& th : pool) {
+        th.join();
+    }
+    const int best = min_element(scores.begin(), scores.end()) - scores.begin();
+    const int best_extra = min_element(extra_scores.begin(), extra_scores.end()) - extra_scores.begin();
+    LOG_INFO("restarts (solver_001) = " << (int)next_restart);
+    LOG_INFO("best_restart (solver_001) = " << best);
+    if(extra_scores[best_extra] < scores[best]) {
+        LOG_INFO("lookahead restart wins (solver_001) = " << extra_scores[best_extra]);
+        return extra_results[best_extra].unpack();
+    }
+    return results[best].unpack();
+}
+
+void solve(const Context& ctx, double deadline, Incumbent& incumbent) {
+    PROFILE_SCOPE(solver_001);
+    solve_restarts(ctx, restart_count, deadline, incumbent);
+}
+
+}; // namespace solver_001
+
+#endif
+#ifndef __SOLVER_002_HPP__
+#define __SOLVER_002_HPP__
+
+#include <algorithm>
+#include <unordered_set>
+#include <tuple>
+
+extern thread_local Input in;
+extern thread_local RandGenerator ryuka;
+extern Timer toki;
+
+namespace solver_002 {
+
+constexpr int branch = 3;
+constexpr int max_width = 8192;
+
+using sovler_001::Dispatcher;
+using sovler_001::evaluate;
+
+struct Node {
+    Dispatcher dispatcher;
+    long long eval;
+};
+
+uint64_t node_key(const Dispatcher& d) {
+    uint64_t key = d.term.hash;
+    for(int i = 0; i < n; i++) {
+        const Crane& c = d.term.cranes[i];
+        const uint64_t task = (uint64_t)c.status << 24 | (uint64_t)(uint8_t)c.catch_i << 18 | (uint64_t)(uint8_t)c.catch_j << 12
+                            | (uint64_t)(uint8_t)c.release_i << 6 | (uint64_t)(uint8_t)c.release_j;
+        key ^= (task + 1) * 0x9e3779b97f4a7c15ull * (i + 1);
+    }
+    return key;
+}
+
+void solve(const Context& ctx, double deadline, Incumbent& incumbent) {
+    PROFILE_SCOPE(solver_002);
+
+    vector<Node> beam(1);
+    beam[0].dispatcher.init(in, false);
+    beam[0].eval = evaluate(beam[0].dispatcher.term);
+
+    PackedActions best;
+    long long best_score = common::INVALID_SCORE;
+    int width = 64;
+
+    while(!beam.empty() && beam[0].dispatcher.term.turn_count < MAX_TURN && !incumbent.stopped() && toki.elapsed() < deadline) {
+        const double turn_start = toki.elapsed();
+        vector<Node> next;
+        next.reserve(beam.size() * branch);
+        auto push = [&](Dispatcher& d) -> void {
+            d.end_turn(ryuka.engine);
+            PROFILE_COUNT(beam_nodes);
+            next.push_back(Node{d, evaluate(d.term)});
+        };
+        for(Node& node : beam) {
+            Dispatcher& d = node.dispatcher;
+            if(!d.begin_turn()) {
+                continue;
+            }
+            int free_crane = -1;
+            vector<tuple<int, int, int>> candidates;
+            for(int i = 0; i < n && free_crane == -1; i++) {
+                if(!d.term.cranes[i].exist || d.term.cranes[i].status != CraneStatus::FREE) {
+                    continue;
+                }
+                int rank = 0;
+                for(const int t : d.cr_tasks) {
+                    const int cost = d.assignment_cost(i, t);
+                    if(cost != -1) {
+                        candidates.emplace_back(cost, rank, t);
                     }
+                    rank++;
+                }
+                if(!candidates.empty()) {
+                    free_crane = i;
                 }
             }
-        };
+            if(free_crane == -1) {
+                d.assign_free_cranes();
+                push(d);
+                continue;
+            }
+            const int k = min((int)candidates.size(), branch);
+            partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+            for(int c = 0; c < k; c++) {
+                Dispatcher child = (c + 1 == k ? move(d) : d);
+                child.assign(free_crane, get<2>(candidates[c]));
+                child.assign_free_cranes();
+                push(child);
+            }
+        }
 
-        term.update1();
-        update_cr_tasks();
-        cerr << "cr_tasks.size() = " << cr_tasks.size() << endl;
-        for(auto cr: cr_tasks) {
-            cerr << cr.catch_i << "," << cr.catch_j << "->" << cr.release_i << "," << cr.release_j << endl;
+        for(const Node& node : next) {
+            if(node.dispatcher.finished()) {
+                const long long score = common::score(in, node.dispatcher.res.unpack());
+                if(score < best_score) {
+                    best_score = score;
+                    best = node.dispatcher.res;
+                    incumbent.publish(ctx, best);
+                }
+            }
         }
-        for(int i = 0; i < n; i++) {
-            cerr << "crane #" << i << ": " << term.cranes[i]->status << endl;
+        if(!next.empty() && min(best_score, incumbent.bound()) <= next[0].dispatcher.term.turn_count + 1) {
+            beam.clear();
+            break;
         }
 
-        vector<ActionType> actions(n, ActionType::WAIT);
-        vector<vector<shared_ptr<Crane>>> next_crane_pos(n, vector<shared_ptr<Crane>>(n, nullptr)); 
+        sort(next.begin(), next.end(), [](const Node& a, const Node& b) { return a.eval > b.eval; });
+        unordered_set<uint64_t> seen;
+        beam.clear();
+        for(Node& node : next) {
+            if((int)beam.size() >= width) {
+                break;
+            }
+            if(node.dispatcher.finished() || !seen.insert(node_key(node.dispatcher)).second) {
+                continue;
+            }
+            beam.push_back(move(node));
+        }
 
-        for(int i = 0; i < n; i++) {
-            if(!term.cranes[i]->exist) {
-                actions[i] = ActionType::DESTROYED;
+        if(!next.empty() && !beam.empty()) {
+            const double per_child = max(1e-7, (toki.elapsed() - turn_start) / next.size());
+            const double remaining = deadline - toki.elapsed();
+            const int remaining_turns = 8 * beam[0].dispatcher.term.remaining_containers() + 10;
+            width = clamp((int)(remaining / (remaining_turns * branch * per_child)), 1, min(max_width, 2 * width));
+        }
+    }
+
+    if(best_score == common::INVALID_SCORE && !beam.empty()) {
+        incumbent.publish(ctx, beam[0].dispatcher.res);
+    }
+    LOG_INFO("score (solver_002) = " << best_score);
+
+}
+
+} // namespace solver_002
+
+#endif
+#ifndef __SOLVER_003_HPP__
+#define __SOLVER_003_HPP__
+
+#ifndef __STATE_HPP__
+#define __STATE_HPP__
+
+#include <numeric>
+#include <algorithm>
+#include <memory>
+
+using namespace std;
+
+extern thread_local Input in;
+extern thread_local RandGenerator ryuka;
+
+using sovler_001::Dispatcher;
+
+struct Checkpoint {
+    Dispatcher dispatcher;
+    int crane;          // crane that decides; cranes before it already did this turn
+    int candidates;     // number of tasks it may take
+};
+
+struct State {
+    static constexpr long long inf = 1LL<<60;
+    long long score;                    // -common::score, larger is better
+    const Input* input;                 // carried along so any thread can decode
+    int turn_limit;                     // decoding gives up after this many turns
+    vector<int> genes;
+    vector<shared_ptr<const Checkpoint>> checkpoints;
+    PackedActions result;
+    State() : score(-inf), input(&in), turn_limit(MAX_TURN) {};
+    long long calc_score();
+    void simulate(int from);
+    static State initState();
+    static State generateState(const State& input_state);
+};
+
+long long State::calc_score() {
+    return score;
+}
+
+vector<int> sorted_tasks(const Dispatcher& d, int i) {
+    vector<pair<int, int>> cost_id;
+    for(const int t : d.cr_tasks) {
+        const int cost = d.assignment_cost(i, t);
+        if(cost != -1) {
+            cost_id.emplace_back(cost, t);
+        }
+    }
+    stable_sort(cost_id.begin(), cost_id.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    vector<int> res;
+    for(auto [cost, t] : cost_id) {
+        res.push_back(t);
+    }
+    return res;
+}
+
+void State::simulate(int from) {
+    Dispatcher d;
+    int crane = 0;
+    if(from < (int)checkpoints.size()) {
+        d = checkpoints[from]->dispatcher;
+        crane = checkpoints[from]->crane;
+    } else {
+        from = 0;
+        d.init(*input, false);
+        if(!d.begin_turn()) {
+            return;
+        }
+    }
+    checkpoints.resize(from);
+    int k = from;
+    while(true) {
+        for(int i = crane; i < n; i++) {
+            if(!d.term.cranes[i].exist || d.term.cranes[i].status != CraneStatus::FREE) {
                 continue;
             }
-            if(term.cranes[i]->status == CraneStatus::FREE) {
-                int best_task_id = -1;
-                int min_dist = 100000;
-                for(int t = 0; t < cr_tasks.size(); t++) {
-                    if(!term.container_pos[cr_tasks[t].catch_i][cr_tasks[t].catch_j]) {
-                        continue;
-                    }
-                    if(i != 0 && cr_tasks[t].large_job) {
-                        continue;
+            const vector<int> tasks = sorted_tasks(d, i);
+            if(tasks.empty()) {
+                continue;
+            }
+            checkpoints.push_back(make_shared<const Checkpoint>(Checkpoint{d, i, (int)tasks.size()}));
+            if(k >= (int)genes.size()) {
+                genes.push_back(0);
+            }
+            d.assign(i, tasks[genes[k] % tasks.size()]);
+            k++;
+        }
+        mt19937 engine(d.term.turn_count);
+        d.end_turn(engine);
+        crane = 0;
+        if(d.term.turn_count >= turn_limit || !d.begin_turn()) {
+            break;
+        }
+    }
+    genes.resize(k);
+    result = d.res;
+    score = -common::score(d.term, result.size());
+}
+
+State State::initState() {
+    State res;
+    res.simulate(0);
+    return res;
+}
+
+State State::generateState(const State& input_state) {
+    PROFILE_SCOPE(neighbour);
+    State res = input_state;
+    const int m = res.genes.size();
+    if(m == 0) {
+        return res;
+    }
+    const int type = ryuka.rand(3);
+    int from = 0;
+    if(type == 0 || m < 2) {
+        const int k = ryuka.rand(m);
+        res.genes[k] = ryuka.rand(res.checkpoints[k]->candidates);
+        from = k;
+    } else if(type == 1) {
+        const int a = ryuka.rand(m);
+        const int b = ryuka.rand(m);
+        swap(res.genes[a], res.genes[b]);
+        from = min(a, b);
+    } else {
+        const int a = ryuka.rand(m);
+        const int b = ryuka.rand(m);
+        const int gene = res.genes[a];
+        res.genes.erase(res.genes.begin() + a);
+        res.genes.insert(res.genes.begin() + b, gene);
+        from = min(a, b);
+    }
+    res.simulate(from);
+    res.calc_score();
+    return res;
+}
+
+#endif
+#ifndef __ANNEALER_HPP__
+#define __ANNEALER_HPP__
+
+#include <atomic>
+#include <barrier>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+extern Timer toki;
+extern thread_local RandGenerator ryuka;
+
+template<class STATE>
+struct IterationControl {
+    static constexpr double check_period = 1e-3;    // target seconds between clock reads
+    static constexpr int max_check_interval = 1 << 16;
+    static constexpr int temp_steps = 1024;         // entries of the anneal temperature table
+    long long iteration_counter;
+    long long swap_counter;
+    long long exchange_counter;
+    double average_time;
+    double start_time;
+    long long start_iteration;
+    int check_interval;
+    const atomic<bool>* cancelled;                  // optional; stops the search at the next clock read
+    IterationControl() : iteration_counter(0), swap_counter(0), exchange_counter(0), cancelled(nullptr) {}
+    void start();
+    bool next_batch(double time_limit, double& elapsed_time);
+    STATE climb(double time_limit, STATE initial_state);
+    STATE anneal(double time_limit, double temp_start, double temp_end, STATE initial_state);
+    STATE temper(double time_limit, double temp_min, double temp_max, STATE initial_state,
+                 int replicas = 4, int exchange_interval = 64, int threads = 1);
+};
+
+template<class STATE>
+void IterationControl<STATE>::start() {
+    start_time = toki.gettime();
+    start_iteration = iteration_counter;
+    average_time = 0;
+    check_interval = 1;
+}
+
+template<class STATE>
+bool IterationControl<STATE>::next_batch(double time_limit, double& elapsed_time) {
+    elapsed_time = toki.gettime() - start_time;
+    if(cancelled && cancelled->load(memory_order_relaxed)) {
+        return false;
+    }
+    const long long iterations = iteration_counter - start_iteration;
+    if(iterations == 0) {
+        check_interval = 1;
+        return elapsed_time < time_limit;
+    }
+    average_time = elapsed_time / iterations;
+    const double budget = min(check_period, time_limit - elapsed_time);
+    check_interval = (int)min<double>(max_check_interval, budget / max(average_time, 1e-12));
+    return check_interval >= 1;
+}
+
+template<class STATE>
+STATE IterationControl<STATE>::climb(double time_limit, STATE initial_state) {
+    start();
+    STATE best_state = initial_state;
+    double elapsed_time = 0;
+    LOG_DEBUG("Starts climbing...");
+    while(next_batch(time_limit, elapsed_time)) {
+        for(int k = 0; k < check_interval; k++) {
+            STATE current_state = STATE::generateState(best_state);
+            if(current_state.score > best_state.score) {
+                swap(best_state, current_state);
+                swap_counter++;
+                PROFILE_COUNT(anneal_accepted);
+            }
+            iteration_counter++;
+            PROFILE_COUNT(anneal_iterations);
+        }
+    }
+    LOG_INFO("Iterated " << iteration_counter << " times and swapped " << swap_counter << " times.");
+    return best_state;
+}
+
+template<class STATE>
+STATE IterationControl<STATE>::anneal(double time_limit, double temp_start, double temp_end, STATE initial_state) {
+    start();
+    vector<double> temp_table(temp_steps);
+    for(int k = 0; k < temp_steps; k++) {
+        const double normalized_time = 1.0 * k / (temp_steps - 1);
+        temp_table[k] = pow(temp_start, 1.0 - normalized_time) * pow(temp_end, normalized_time);
+    }
+    STATE best_state = initial_state;
+    double elapsed_time = 0;
+    LOG_DEBUG("Starts annealing...");
+    while(next_batch(time_limit, elapsed_time)) {
+        const int step = clamp((int)(elapsed_time / time_limit * (temp_steps - 1)), 0, temp_steps - 1);
+        const double temp_current = temp_table[step];
+        for(int k = 0; k < check_interval; k++) {
+            STATE current_state = STATE::generateState(best_state);
+            long long delta = current_state.score - best_state.score;
+            if(delta > 0 || ryuka.pjudge(exp(1.0 * delta / temp_current)) ) {
+                swap(best_state, current_state);
+                swap_counter++;
+                PROFILE_COUNT(anneal_accepted);
+            }
+            iteration_counter++;
+            PROFILE_COUNT(anneal_iterations);
+        }
+    }
+    LOG_INFO("Iterated " << iteration_counter << " times and swapped " << swap_counter << " times.");
+    return best_state;
+}
+
+template<class STATE>
+STATE IterationControl<STATE>::temper(double time_limit, double temp_min, double temp_max, STATE initial_state, int replicas, int exchange_interval, int threads) {
+    start();
+    replicas = max(1, replicas);
+    threads = max(1, min(replicas, threads));
+    vector<double> temps(replicas);
+    for(int r = 0; r < replicas; r++) {
+        const double x = replicas == 1 ? 0.0 : 1.0 * r / (replicas - 1);
+        temps[r] = pow(temp_min, 1.0 - x) * pow(temp_max, x);
+    }
+    vector<STATE> states(replicas, initial_state);
+    vector<STATE> replica_best(replicas, initial_state);
+    vector<long long> iterations(replicas, 0), swaps(replicas, 0);
+    STATE best_state = initial_state;
+    const uint64_t master = ryuka.engine64();
+    mt19937 exchange_engine(RandGenerator::derive(master, replicas));
+    bool done = false;
+    int rounds = 0;
+    LOG_DEBUG("Starts tempering with " << replicas << " replicas on " << threads << " threads...");
+
+    auto exchange = [&]() noexcept {
+        rounds++;
+        for(int r = 0; r < replicas; r++) {
+            if(replica_best[r].score > best_state.score) {
+                best_state = replica_best[r];
+            }
+        }
+        for(int r = rounds % 2; r + 1 < replicas; r += 2) {
+            const double x = (states[r+1].score - states[r].score) * (1.0 / temps[r] - 1.0 / temps[r+1]);
+            if(x >= 0 || uniform_real_distribution<double>(0, 1)(exchange_engine) < exp(x)) {
+                swap(states[r], states[r+1]);
+                exchange_counter++;
+            }
+        }
+        const double elapsed_time = toki.gettime() - start_time;
+        average_time = elapsed_time / rounds;
+        done = elapsed_time + average_time >= time_limit || (cancelled && cancelled->load(memory_order_relaxed));
+    };
+    barrier sync(threads, exchange);
+
+    auto worker = [&](int tid) {
+        ryuka.init(RandGenerator::derive(master, tid));
+        while(true) {
+            for(int r = tid; r < replicas; r += threads) {
+                for(int it = 0; it < exchange_interval; it++) {
+                    if(cancelled && cancelled->load(memory_order_relaxed)) {
+                        break;
                     }
-                    int dist =  abs(term.cranes[i]->i - cr_tasks[t].catch_i) +
-                                abs(term.cranes[i]->j - cr_tasks[t].catch_j);
-                    if(term.cranes[i]->prev_container_id == term.container_pos[cr_tasks[t].catch_i][cr_tasks[t].catch_j]->id) {
-                        if(term.cranes[i]->crane_type == CraneType::LARGE) {
-                            dist += 1000;
-                        } else {
-                            dist += 1000000;
+                    STATE next_state = STATE::generateState(states[r]);
+                    long long delta = next_state.score - states[r].score;
+                    if(delta > 0 || ryuka.pjudge(exp(1.0 * delta / temps[r]))) {
+                        swap(states[r], next_state);
+                        swaps[r]++;
+                        PROFILE_COUNT(anneal_accepted);
+                        if(states[r].score > replica_best[r].score) {
+                            replica_best[r] = states[r];
                         }
                     }
-                    if(min_dist > dist) {
-                        min_dist = dist;
-                        best_task_id = t;
-                    }
-                }
-                if(best_task_id != -1) {
-                    const CR_task cr = cr_tasks[best_task_id];
-                    cerr << "cr " << i << ":" << cr.catch_i << "," << cr.catch_j << "->" << cr.release_i << "," << cr.release_j << endl;
-                    term.cranes[i]->set_catch_and_release(cr.catch_i, cr.catch_j, cr.release_i, cr.release_j);
-                    erase_cr_tasks(cr.catch_i, cr.catch_j);
+                    iterations[r]++;
+                    PROFILE_COUNT(anneal_iterations);
                 }
             }
-            ActionType act = get_next_action(i, next_crane_pos, term, res);
-            actions[i] = act;
-
-            {
-                auto [di, dj] = common::act2move(actions[i]);
-                const int next_i = term.cranes[i]->i + di;
-                const int next_j = term.cranes[i]->j + dj;
-                next_crane_pos[next_i][next_j] = term.cranes[i]; 
+            sync.arrive_and_wait();
+            if(done) {
+                break;
             }
-        } 
+        }
+    };
+    vector<thread> pool;
+    for(int tid = 0; tid < threads; tid++) {
+        pool.emplace_back(worker, tid);
+    }
+    for(thread& th : pool) {
+        th.join();
+    }
 
-        term.update2(actions);
+    for(int r = 0; r < replicas; r++) {
+        iteration_counter += iterations[r];
+        swap_counter += swaps[r];
+    }
+    LOG_INFO("Iterated " << iteration_counter << " times, swapped " << swap_counter << " times and exchanged " << exchange_counter << " times.");
+    return best_state;
+}
+
+#endif
+
+extern thread_local Input in;
+extern Timer toki;
+
+namespace solver_003 {
+
+constexpr double temp_min = 0.5;
+constexpr double temp_max = 10.0;
+constexpr int min_replicas = 4;
+constexpr int exchange_interval = 32;
+
+void solve(const Context& ctx, double deadline, Incumbent& incumbent) {
+    PROFILE_SCOPE(solver_003);
+
+    State initial_state = State::initState();
+    initial_state.turn_limit = min(MAX_TURN, 2 * (int)initial_state.result.size() + 10);
+
+    incumbent.publish(ctx, initial_state.result);
+
+    IterationControl<State> sa;
+    sa.cancelled = &incumbent.cancelled;
+    const int replicas = max(min_replicas, ctx.threads);
+    const State best_state = sa.temper(deadline - toki.elapsed(), temp_min, temp_max, initial_state, replicas, exchange_interval, ctx.threads);
+    LOG_INFO("score (solver_003) = " << -best_state.score);
+    incumbent.publish(ctx, best_state.result);
+
+}
+
+} // namespace solver_003
+
+#endif
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <fstream>
+#include <string>
+
+struct Trace {
+    static constexpr uint32_t version = 1;
+    Input in;
+    uint64_t seed;
+    int snapshot_interval;
+    vector<uint32_t> actions;       // n 4-bit actions per turn
+    vector<Terminal> snapshots;
+    void init(const Input&, uint64_t seed, int snapshot_interval);
+    void record(const vector<ActionType>& acts, const Terminal& after);
+    static Trace build(const Input&, uint64_t seed, const vector<vector<ActionType>>&, int snapshot_interval);
+    int turns() const { return actions.size(); }
+    vector<ActionType> turn(int t) const;
+    bool save(const string& path) const;
+    bool load(const string& path);
+    bool verify() const;
+};
+
+struct Replayer {
+    const Trace* trace;
+    Terminal term;
+    void init(const Trace& _trace) { trace = &_trace; term.init(trace->in); }
+    SimStatus step();
+    SimStatus seek(int turn);
+};
+
+void Trace::init(const Input& _in, uint64_t _seed, int _snapshot_interval) {
+    in = _in;
+    seed = _seed;
+    snapshot_interval = _snapshot_interval;
+    actions.clear();
+    snapshots.clear();
+}
+
+void Trace::record(const vector<ActionType>& acts, const Terminal& after) {
+    uint32_t packed = 0;
+    for(int k = 0; k < n; k++) {
+        packed |= (uint32_t)acts[k] << (4*k);
+    }
+    actions.push_back(packed);
+    if(snapshot_interval > 0 && turns() % snapshot_interval == 0) {
+        snapshots.push_back(after);
+    }
+}
+
+Trace Trace::build(const Input& in, uint64_t seed, const vector<vector<ActionType>>& res, int snapshot_interval) {
+    Trace trace;
+    trace.init(in, seed, snapshot_interval);
+    Terminal term;
+    term.init(in);
+    int len = 0;
+    for(const auto& row : res) {
+        len = max(len, (int)row.size());
+    }
+    vector<ActionType> acts(n);
+    for(int t = 0; t < len; t++) {
+        for(int k = 0; k < n; k++) {
+            if(k < (int)res.size() && t < (int)res[k].size()) {
+                acts[k] = res[k][t];
+            } else {
+                acts[k] = term.cranes[k].exist ? ActionType::WAIT : ActionType::DESTROYED;
+            }
+        }
+        term.update1();
+        if(!term.referee2(acts).ok()) {
+            break;
+        }
         term.update3();
-        copy2res(res, actions);
+        trace.record(acts, term);
+    }
+    return trace;
+}
 
-        cerr << "turn_count (solver_001) = " << term.turn_count << endl;
+vector<ActionType> Trace::turn(int t) const {
+    vector<ActionType> res(n);
+    for(int k = 0; k < n; k++) {
+        res[k] = (ActionType)(actions[t] >> (4*k) & 15);
     }
     return res;
+}
 
+bool Trace::save(const string& path) const {
+    ofstream ofs(path, ios::binary);
+    if(!ofs) {
+        return false;
+    }
+    auto put = [&](const auto& x) { ofs.write((const char*)&x, sizeof(x)); };
+    ofs.write("AHCT", 4);
+    put(version);
+    put((uint32_t)sizeof(Terminal));
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n; j++) {
+            put((int8_t)in.a[i][j]);
+        }
+    }
+    put(seed);
+    put(snapshot_interval);
+    put(turns());
+    for(const uint32_t packed : actions) {
+        ofs.write((const char*)&packed, 3);
+    }
+    put((int)snapshots.size());
+    ofs.write((const char*)snapshots.data(), snapshots.size() * sizeof(Terminal));
+    return (bool)ofs;
 }
 
-}; // namespace solver_001
+bool Trace::load(const string& path) {
+    ifstream ifs(path, ios::binary);
+    auto get = [&](auto& x) { ifs.read((char*)&x, sizeof(x)); };
+    char magic[4];
+    ifs.read(magic, 4);
+    uint32_t file_version, terminal_size;
+    get(file_version);
+    get(terminal_size);
+    if(!ifs || memcmp(magic, "AHCT", 4) != 0 || file_version != version || terminal_size != sizeof(Terminal)) {
+        return false;
+    }
+    in.a.assign(n, vector<int>(n));
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n; j++) {
+            int8_t x;
+            get(x);
+            in.a[i][j] = x;
+        }
+    }
+    get(seed);
+    get(snapshot_interval);
+    int len = -1;
+    get(len);
+    if(!ifs || len < 0 || len > MAX_TURN) {
+        return false;
+    }
+    actions.assign(len, 0);
+    for(uint32_t& packed : actions) {
+        ifs.read((char*)&packed, 3);
+    }
+    int count = -1;
+    get(count);
+    if(!ifs || count < 0 || count > len) {
+        return false;
+    }
+    snapshots.resize(count);
+    ifs.read((char*)snapshots.data(), count * sizeof(Terminal));
+    return ifs && verify();
+}
+
+bool Trace::verify() const {
+    Terminal term;
+    term.init(in);
+    size_t k = 0;
+    for(int t = 0; t < turns(); t++) {
+        term.update1();
+        if(!term.referee2(turn(t)).ok()) {
+            return false;
+        }
+        term.update3();
+        if(snapshot_interval > 0 && term.turn_count % snapshot_interval == 0 && k < snapshots.size()) {
+            const Terminal& snapshot = snapshots[k++];
+            if(snapshot.turn_count != term.turn_count || snapshot.hash != term.hash) {
+                return false;
+            }
+        }
+    }
+    return k == snapshots.size();
+}
+
+SimStatus Replayer::step() {
+    const Terminal before = term;
+    term.update1();
+    const SimStatus status = term.referee2(trace->turn(term.turn_count - 1));
+    if(status.ok()) {
+        term.update3();
+    } else {
+        term = before;
+    }
+    return status;
+}
+
+SimStatus Replayer::seek(int turn) {
+    assert(0 <= turn && turn <= trace->turns());
+    const int k = trace->snapshot_interval > 0 ? min(turn / trace->snapshot_interval, (int)trace->snapshots.size()) : 0;
+    if(!(term.turn_count <= turn && (k == 0 || term.turn_count >= k * trace->snapshot_interval))) {
+        if(k == 0) {
+            term.init(trace->in);
+        } else {
+            term = trace->snapshots[k-1];
+        }
+    }
+    while(term.turn_count < turn) {
+        const SimStatus status = step();
+        if(!status.ok()) {
+            return status;
+        }
+    }
+    return SimStatus{SimError::ERR_NONE, term.turn_count, -1};
+}
 
 #endif
-#ifndef __TOKI_HPP__
-#define __TOKI_HPP__
+#ifndef __PORTFOLIO_HPP__
+#define __PORTFOLIO_HPP__
 
-#include <sys/time.h>
-#include <cstddef>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <thread>
 
-struct Timer {
+extern thread_local RandGenerator ryuka;
+extern thread_local Input in;
+extern Timer toki;
 
-    double global_start;
-    
-    double gettime() {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        return tv.tv_sec + tv.tv_usec * 1e-6;
+struct Portfolio {
+    using Solver = function<void(const Context&, double deadline, Incumbent&)>;
+    struct Entry {
+        string name;
+        Solver solve;
+        bool parallel;          // uses Context::threads threads instead of just its own
+    };
+    vector<Entry> entries;
+    Incumbent incumbent;
+    vector<thread> threads;
+    mutex mtx;
+    condition_variable done_cv;
+    int done_count = 0;
+    ~Portfolio() { join(); }
+    void add(const string& name, Solver solve, bool parallel = false);
+    vector<vector<ActionType>> run(const Input& in, uint64_t seed, double deadline, int budget, double grace = 0.1);
+    void join();
+};
+
+void Portfolio::add(const string& name, Solver solve, bool parallel) {
+    entries.push_back(Entry{name, solve, parallel});
+}
+
+vector<vector<ActionType>> Portfolio::run(const Input& in, uint64_t seed, double deadline, int budget, double grace) {
+    const int parallel_count = count_if(entries.begin(), entries.end(), [](const Entry& e) { return e.parallel; });
+    const int spare = max(0, budget - ((int)entries.size() - parallel_count));
+    for(int k = 0, p = 0; k < (int)entries.size(); k++) {
+        int share = 1;
+        if(entries[k].parallel) {
+            share = max(1, spare / parallel_count + (p < spare % parallel_count));
+            p++;
+        }
+        LOG_DEBUG(entries[k].name << " threads = " << share);
+        threads.emplace_back([this, k, share, in, seed, deadline]() {
+            const Context ctx{in, RandGenerator::derive(seed, k), entries[k].name, share};
+            ryuka.init(ctx.seed);
+            ::in = ctx.in;
+            entries[k].solve(ctx, deadline, incumbent);
+            lock_guard<mutex> lock(mtx);
+            done_count++;
+            done_cv.notify_all();
+        });
     }
-    
-    void init() {
-        global_start = gettime();
+    {
+        unique_lock<mutex> lock(mtx);
+        const chrono::duration<double> wait(max(0.0, deadline + grace - toki.elapsed()));
+        done_cv.wait_for(lock, wait, [&]() { return done_count == (int)entries.size(); });
     }
-    
-    double elapsed() {
-        return gettime() - global_start;
+    incumbent.cancel();
+    LOG_INFO("best = " << incumbent.bound());
+    return incumbent.get();
+}
+
+void Portfolio::join() {
+    incumbent.cancel();
+    for(thread& th : threads) {
+        th.join();
     }
-} toki;
+    threads.clear();
+}
+
+#endif
+#ifndef __RUNNER_HPP__
+#define __RUNNER_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <glob.h>
+#include <string>
+#include <thread>
+
+extern thread_local Input in;
+extern Timer toki;
+
+namespace runner {
+
+struct Options {
+    string pattern;             // directory (every *.txt in it) or glob
+    string out_dir = "out";
+    string csv_path;            // default: <out_dir>/results.csv
+    int threads = thread::hardware_concurrency();   // budget of the whole batch
+    int instance_threads = 1;   // of the budget, what one instance's solve gets; threads / instance_threads instances run at once
+    double time_limit = 2.5;    // seconds per instance
+};
+
+struct Row {
+    string name;
+    long long score;
+    int turns;
+    double time;
+};
+
+using Solve = function<vector<vector<ActionType>>(double deadline, int threads)>;
+
+vector<string> collect_inputs(const string& pattern) {
+    vector<string> res;
+    if(filesystem::is_directory(pattern)) {
+        for(const auto& entry : filesystem::directory_iterator(pattern)) {
+            if(entry.is_regular_file() && entry.path().extension() == ".txt") {
+                res.push_back(entry.path().string());
+            }
+        }
+    } else {
+        glob_t g;
+        if(glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+            for(size_t k = 0; k < g.gl_pathc; k++) {
+                res.push_back(g.gl_pathv[k]);
+            }
+        }
+        globfree(&g);
+    }
+    sort(res.begin(), res.end());
+    return res;
+}
+
+bool parse(int argc, char** argv, Options& opt) {
+    for(int k = 1; k < argc; k++) {
+        const string key = argv[k];
+        if(k + 1 >= argc) {
+            return false;
+        }
+        const string value = argv[++k];
+        if(key == "--batch") opt.pattern = value;
+        else if(key == "--out") opt.out_dir = value;
+        else if(key == "--csv") opt.csv_path = value;
+        else if(key == "--threads") opt.threads = max(1, atoi(value.c_str()));
+        else if(key == "--instance-threads") opt.instance_threads = max(1, atoi(value.c_str()));
+        else if(key == "--time") opt.time_limit = atof(value.c_str());
+        else return false;
+    }
+    if(opt.csv_path.empty()) {
+        opt.csv_path = opt.out_dir + "/results.csv";
+    }
+    return !opt.pattern.empty();
+}
+
+int run(const Options& opt, uint64_t seed, const Solve& solve) {
+    const vector<string> files = collect_inputs(opt.pattern);
+    filesystem::create_directories(opt.out_dir);
+    vector<Row> rows(files.size());
+    atomic<int> next_file(0);
+    const int instance_threads = max(1, min(opt.instance_threads, opt.threads));
+    auto worker = [&]() {
+        for(int k = next_file++; k < (int)files.size(); k = next_file++) {
+            ifstream ifs(files[k]);
+            in.read(ifs);
+            ryuka.init(RandGenerator::derive(seed, k));
+            const double start = toki.elapsed();
+            const vector<vector<ActionType>> ans = solve(start + opt.time_limit, instance_threads);
+            Row& row = rows[k];
+            row.name = filesystem::path(files[k]).filename().string();
+            row.time = toki.elapsed() - start;
+            row.score = common::score(in, ans);
+            row.turns = 0;
+            for(const auto& line : ans) {
+                row.turns = max(row.turns, (int)count_if(line.begin(), line.end(), [](ActionType act) { return act != ActionType::DESTROYED; }));
+            }
+            ofstream ofs(opt.out_dir + "/" + row.name);
+            common::print(ans, ofs);
+        }
+    };
+    vector<thread> pool;
+    for(int t = 0; t < max(1, opt.threads / instance_threads); t++) {
+        pool.emplace_back(worker);
+    }
+    for(thread& th : pool) {
+        th.join();
+    }
+
+    ofstream csv(opt.csv_path);
+    csv << "input,score,turns,time\n";
+    for(const Row& row : rows) {
+        csv << row.name << "," << row.score << "," << row.turns << "," << fixed << setprecision(4) << row.time << "\n";
+    }
+
+    if(!rows.empty()) {
+        double mean = 0, var = 0, max_time = 0;
+        int best = 0, worst = 0;
+        for(int k = 0; k < (int)rows.size(); k++) {
+            mean += (double)rows[k].score / rows.size();
+            max_time = max(max_time, rows[k].time);
+            if(rows[k].score < rows[best].score) best = k;
+            if(rows[k].score > rows[worst].score) worst = k;
+        }
+        for(const Row& row : rows) {
+            var += (row.score - mean) * (row.score - mean) / max(1, (int)rows.size() - 1);
+        }
+        cout << "instances = " << rows.size() << "\n";
+        cout << fixed << setprecision(4);
+        cout << "score_mean = " << mean << "\n";
+        cout << "score_min = " << rows[best].score << "\n";
+        cout << "score_min_input = " << rows[best].name << "\n";
+        cout << "score_max = " << rows[worst].score << "\n";
+        cout << "score_max_input = " << rows[worst].name << "\n";
+        cout << "score_stdev = " << sqrt(var) << "\n";
+        cout << "max_time = " << max_time << endl;
+    }
+    return rows.size();
+}
+
+} // namespace runner
 
 #endif
 #include <iostream>
+#include <cstdlib>
 using namespace std;
 
-Input in;
+thread_local Input in;
 extern Timer toki;
 
-int main() {
+// default deadline: the portfolio answers once toki.elapsed() reaches it
+constexpr double time_limit = 2.5;
+
+// every solver runs on its own thread and publishes to a shared incumbent;
+// whatever it holds at the deadline is the answer
+void add_solvers(Portfolio& portfolio) {
+    portfolio.add("solver_000", [](const Context& ctx, double deadline, Incumbent& incumbent) { solver_000::solve(ctx, deadline, incumbent); });
+    portfolio.add("solver_001", [](const Context& ctx, double deadline, Incumbent& incumbent) { sovler_001::solve(ctx, deadline, incumbent); }, true);
+    portfolio.add("solver_002", [](const Context& ctx, double deadline, Incumbent& incumbent) { solver_002::solve(ctx, deadline, incumbent); });
+    portfolio.add("solver_003", [](const Context& ctx, double deadline, Incumbent& incumbent) { solver_003::solve(ctx, deadline, incumbent); }, true);
+}
+
+// threads is the budget of the whole portfolio, solver_001's restarts and solver_003's
+// replicas included
+vector<vector<ActionType>> solve(double deadline, int threads) {
+    Portfolio portfolio;
+    add_solvers(portfolio);
+    return portfolio.run(in, ryuka.seed, deadline, threads);
+}
+
+int main(int argc, char** argv) {
 
     toki.init();
-    in.read();
+    // a failed assert prints the last debug lines of every thread
+    logger::install_crash_handler();
+    // AHC_SEED=<u64> reproduces a run whose seed was recorded in a trace
+    if(const char* seed = getenv("AHC_SEED")) {
+        ryuka.init(strtoull(seed, nullptr, 10));
+    }
 
-    vector<vector<ActionType>> ans = solver_000::solve();
-    vector<vector<ActionType>> ans_001 = sovler_001::solve();
-    if(ans_001.front().size() < ans.front().size()) {
-        ans = ans_001;
+    // --batch <dir or glob> [--out dir] [--csv path] [--threads k] [--instance-threads k] [--time sec]
+    if(argc > 1) {
+        runner::Options opt;
+        opt.time_limit = time_limit;
+        // one thread per solver of the portfolio
+        opt.instance_threads = 4;
+        if(!runner::parse(argc, argv, opt)) {
+            cerr << "usage: " << argv[0] << " [--batch <dir or glob> [--out dir] [--csv path] [--threads k] [--instance-threads k] [--time sec]]" << endl;
+            return 1;
+        }
+        // per-instance logs would interleave across threads
+        cerr.setstate(ios::badbit);
+        runner::run(opt, ryuka.seed, solve);
+        // totals over the whole batch, next to its summary
+        profile::report(cout);
+        return 0;
     }
-    
+
+    in.read();
+    // the answer is printed (and flushed) before the solver threads are joined: one still
+    // finishing its current step must not delay the output
+    Portfolio portfolio;
+    add_solvers(portfolio);
+    vector<vector<ActionType>> ans = portfolio.run(in, ryuka.seed, time_limit, max(1, (int)thread::hardware_concurrency()));
     common::print(ans);
+    portfolio.join();
+
+    // AHC_TRACE=<path> writes a binary trace of the chosen answer for offline replay
+    if(const char* path = getenv("AHC_TRACE")) {
+        Trace::build(in, ryuka.seed, ans, 100).save(path);
+    }
+
+    // -DAHC_PROFILE: per-phase times and counters, in the log next to the solvers' lines
+    profile::report(cerr);
+
+    // AHC_LOG_DUMP=1 prints the debug ring buffers even when nothing failed
+    if(getenv("AHC_LOG_DUMP")) {
+        logger::dump();
+    }
 
 }
\ No newline at end of file
@@ -82,7 +82,8 @@ def run(seed: int, options: List = []) -> Tuple[ResultType, float, float]:
         return ResultType.JUDGE_FAILED, 0, elapsed_time
     
 def measure(options: List = []):
-    os.system(f"g++ -O2 -std=c++20 src/main.cpp -o {solver}")
+    # ログの key = value 行（info）は既定のレベルでは消えるので、ローカルではデバッグまで残す
+    os.system(f"g++ -O2 -std=c++20 -DAHC_LOG_LEVEL=1 src/main.cpp -o {solver}")
     results = joblib.Parallel(n_jobs=num_parallel) (
         joblib.delayed(run)(seed, options) for seed in range(num_testcases)
     )
@@ -100,7 +101,7 @@ def objective(trial: optuna.trial.Trial):
     return score
         
 def optimize(options: List = []):  
-    os.system(f"g++ -O2 -std=c++20 src/main.cpp -DOPTUNA -o {solver}")  
+    os.system(f"g++ -O2 -std=c++20 -DAHC_LOG_LEVEL=1 src/main.cpp -DOPTUNA -o {solver}")  
     study = optuna.create_study(
         direction="maximize",
         storage="sqlite:///ahc.db",
@@ -3,63 +3,209 @@
 
 #include "toki.hpp"
 #include "ryuka.hpp"
+#include "profile.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <barrier>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 
 extern Timer toki;
-extern RandGenerator ryuka;
+extern thread_local RandGenerator ryuka;
 
 template<class STATE>
 struct IterationControl {
+    static constexpr double check_period = 1e-3;    // target seconds between clock reads
+    static constexpr int max_check_interval = 1 << 16;
+    static constexpr int temp_steps = 1024;         // entries of the anneal temperature table
     long long iteration_counter;
     long long swap_counter;
+    long long exchange_counter;
     double average_time;
     double start_time;
-    IterationControl() : iteration_counter(0), swap_counter(0) {}
+    long long start_iteration;
+    int check_interval;
+    const atomic<bool>* cancelled;                  // optional; stops the search at the next clock read
+    IterationControl() : iteration_counter(0), swap_counter(0), exchange_counter(0), cancelled(nullptr) {}
+    void start();
+    bool next_batch(double time_limit, double& elapsed_time);
     STATE climb(double time_limit, STATE initial_state);
     STATE anneal(double time_limit, double temp_start, double temp_end, STATE initial_state);
+    STATE temper(double time_limit, double temp_min, double temp_max, STATE initial_state,
+                 int replicas = 4, int exchange_interval = 64, int threads = 1);
 };
 
 template<class STATE>
-STATE IterationControl<STATE>::climb(double time_limit, STATE initial_state) {
+void IterationControl<STATE>::start() {
     start_time = toki.gettime();
+    start_iteration = iteration_counter;
     average_time = 0;
+    check_interval = 1;
+}
+
+// reads the clock and sizes the next batch so that it ends within check_period and
+// within time_limit; false once not even one more iteration fits
+template<class STATE>
+bool IterationControl<STATE>::next_batch(double time_limit, double& elapsed_time) {
+    elapsed_time = toki.gettime() - start_time;
+    if(cancelled && cancelled->load(memory_order_relaxed)) {
+        return false;
+    }
+    const long long iterations = iteration_counter - start_iteration;
+    if(iterations == 0) {
+        check_interval = 1;
+        return elapsed_time < time_limit;
+    }
+    average_time = elapsed_time / iterations;
+    const double budget = min(check_period, time_limit - elapsed_time);
+    check_interval = (int)min<double>(max_check_interval, budget / max(average_time, 1e-12));
+    return check_interval >= 1;
+}
+
+template<class STATE>
+STATE IterationControl<STATE>::climb(double time_limit, STATE initial_state) {
+    start();
     STATE best_state = initial_state;
-    double time_stamp = start_time;
-    cerr << "Starts climbing...\n";
-    while(time_stamp - start_time + average_time < time_limit) {
-        STATE current_state = STATE::generateState(best_state);
-        if(current_state.score > best_state.score) {
-            swap(best_state, current_state);
-            swap_counter++;
+    double elapsed_time = 0;
+    LOG_DEBUG("Starts climbing...");
+    while(next_batch(time_limit, elapsed_time)) {
+        for(int k = 0; k < check_interval; k++) {
+            STATE current_state = STATE::generateState(best_state);
+            if(current_state.score > best_state.score) {
+                swap(best_state, current_state);
+                swap_counter++;
+                PROFILE_COUNT(anneal_accepted);
+            }
+            iteration_counter++;
+            PROFILE_COUNT(anneal_iterations);
         }
-        iteration_counter++;
-        time_stamp = toki.gettime();
-        average_time = (time_stamp - start_time) / iteration_counter;
     }
-    cerr << "Iterated " << iteration_counter << " times and swapped " << swap_counter << " times.\n";
+    LOG_INFO("Iterated " << iteration_counter << " times and swapped " << swap_counter << " times.");
     return best_state;
 }
 
 template<class STATE>
 STATE IterationControl<STATE>::anneal(double time_limit, double temp_start, double temp_end, STATE initial_state) {
-    start_time = toki.gettime();
-    average_time = 0;
+    start();
+    // geometric schedule, sampled once per batch
+    vector<double> temp_table(temp_steps);
+    for(int k = 0; k < temp_steps; k++) {
+        const double normalized_time = 1.0 * k / (temp_steps - 1);
+        temp_table[k] = pow(temp_start, 1.0 - normalized_time) * pow(temp_end, normalized_time);
+    }
     STATE best_state = initial_state;
     double elapsed_time = 0;
-    cerr << "Starts annealing...\n";
-    while(elapsed_time + average_time < time_limit) {
-        double normalized_time = elapsed_time / time_limit;
-        double temp_current = pow(temp_start, 1.0 - normalized_time) * pow(temp_end, normalized_time);
-        STATE current_state = STATE::generateState(best_state);
-        long long delta = current_state.score - best_state.score;
-        if(delta > 0 || ryuka.pjudge(exp(1.0 * delta / temp_current)) ) {
-            swap(best_state, current_state);
-            swap_counter++;
+    LOG_DEBUG("Starts annealing...");
+    while(next_batch(time_limit, elapsed_time)) {
+        const int step = clamp((int)(elapsed_time / time_limit * (temp_steps - 1)), 0, temp_steps - 1);
+        const double temp_current = temp_table[step];
+        for(int k = 0; k < check_interval; k++) {
+            STATE current_state = STATE::generateState(best_state);
+            long long delta = current_state.score - best_state.score;
+            if(delta > 0 || ryuka.pjudge(exp(1.0 * delta / temp_current)) ) {
+                swap(best_state, current_state);
+                swap_counter++;
+                PROFILE_COUNT(anneal_accepted);
+            }
+            iteration_counter++;
+            PROFILE_COUNT(anneal_iterations);
         }
-        iteration_counter++;
-        elapsed_time = toki.gettime() - start_time;
-        average_time = elapsed_time / iteration_counter;
     }
-    cerr << "Iterated " << iteration_counter << " times and swapped " << swap_counter << " times.\n";
+    LOG_INFO("Iterated " << iteration_counter << " times and swapped " << swap_counter << " times.");
+    return best_state;
+}
+
+// parallel tempering: replicas at a geometric ladder of fixed temperatures run
+// exchange_interval iterations each, then adjacent replicas try to swap states.
+// replicas share a pool of min(threads, replicas) threads; the best state any replica has
+// seen is returned. the caller's ryuka seeds every replica, so a run is
+// reproducible for a fixed number of threads and rounds.
+template<class STATE>
+STATE IterationControl<STATE>::temper(double time_limit, double temp_min, double temp_max, STATE initial_state, int replicas, int exchange_interval, int threads) {
+    start();
+    replicas = max(1, replicas);
+    threads = max(1, min(replicas, threads));
+    vector<double> temps(replicas);
+    for(int r = 0; r < replicas; r++) {
+        const double x = replicas == 1 ? 0.0 : 1.0 * r / (replicas - 1);
+        temps[r] = pow(temp_min, 1.0 - x) * pow(temp_max, x);
+    }
+    vector<STATE> states(replicas, initial_state);
+    vector<STATE> replica_best(replicas, initial_state);
+    vector<long long> iterations(replicas, 0), swaps(replicas, 0);
+    STATE best_state = initial_state;
+    const uint64_t master = ryuka.engine64();
+    mt19937 exchange_engine(RandGenerator::derive(master, replicas));
+    bool done = false;
+    int rounds = 0;
+    LOG_DEBUG("Starts tempering with " << replicas << " replicas on " << threads << " threads...");
+
+    // runs on one thread between rounds, while the others wait at the barrier
+    auto exchange = [&]() noexcept {
+        rounds++;
+        for(int r = 0; r < replicas; r++) {
+            if(replica_best[r].score > best_state.score) {
+                best_state = replica_best[r];
+            }
+        }
+        // 偶数番目と奇数番目の組を交互に試す
+        for(int r = rounds % 2; r + 1 < replicas; r += 2) {
+            const double x = (states[r+1].score - states[r].score) * (1.0 / temps[r] - 1.0 / temps[r+1]);
+            if(x >= 0 || uniform_real_distribution<double>(0, 1)(exchange_engine) < exp(x)) {
+                swap(states[r], states[r+1]);
+                exchange_counter++;
+            }
+        }
+        const double elapsed_time = toki.gettime() - start_time;
+        average_time = elapsed_time / rounds;
+        done = elapsed_time + average_time >= time_limit || (cancelled && cancelled->load(memory_order_relaxed));
+    };
+    barrier sync(threads, exchange);
+
+    auto worker = [&](int tid) {
+        ryuka.init(RandGenerator::derive(master, tid));
+        while(true) {
+            for(int r = tid; r < replicas; r += threads) {
+                for(int it = 0; it < exchange_interval; it++) {
+                    // a round of slow moves can outlast the deadline; cut it short once cancelled
+                    if(cancelled && cancelled->load(memory_order_relaxed)) {
+                        break;
+                    }
+                    STATE next_state = STATE::generateState(states[r]);
+                    long long delta = next_state.score - states[r].score;
+                    if(delta > 0 || ryuka.pjudge(exp(1.0 * delta / temps[r]))) {
+                        swap(states[r], next_state);
+                        swaps[r]++;
+                        PROFILE_COUNT(anneal_accepted);
+                        if(states[r].score > replica_best[r].score) {
+                            replica_best[r] = states[r];
+                        }
+                    }
+                    iterations[r]++;
+                    PROFILE_COUNT(anneal_iterations);
+                }
+            }
+            sync.arrive_and_wait();
+            if(done) {
+                break;
+            }
+        }
+    };
+    vector<thread> pool;
+    for(int tid = 0; tid < threads; tid++) {
+        pool.emplace_back(worker, tid);
+    }
+    for(thread& th : pool) {
+        th.join();
+    }
+
+    for(int r = 0; r < replicas; r++) {
+        iteration_counter += iterations[r];
+        swap_counter += swaps[r];
+    }
+    LOG_INFO("Iterated " << iteration_counter << " times, swapped " << swap_counter << " times and exchanged " << exchange_counter << " times.");
     return best_state;
 }
 
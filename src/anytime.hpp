@@ -0,0 +1,62 @@
+#ifndef __ANYTIME_HPP__
+#define __ANYTIME_HPP__
+
+#include "common.hpp"
+#include "packed.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+
+// what a solver gets to know about its run
+struct Context {
+    const Input& in;
+    uint64_t seed;      // master seed of this solver
+    string name;        // shown when it improves the incumbent
+    int threads = 1;    // threads the solver may keep busy, its own included
+};
+
+// best complete answer found so far by any solver, plus the cancellation flag.
+// bound() is lock-free so solvers can poll it in their inner loops: a trajectory
+// that already needs bound() turns can not win (common::score >= turns).
+struct Incumbent {
+    atomic<long long> best_score;
+    atomic<bool> cancelled;
+    mutex mtx;
+    vector<vector<ActionType>> best;
+    string owner;
+    Incumbent() : best_score(common::INVALID_SCORE), cancelled(false) {}
+    long long bound() const { return best_score.load(memory_order_acquire); }
+    bool stopped() const { return cancelled.load(memory_order_relaxed); }
+    void cancel() { cancelled.store(true, memory_order_relaxed); }
+    bool publish(const Context& ctx, const PackedActions& actions);
+    bool publish(const Context& ctx, const vector<vector<ActionType>>& actions);
+    vector<vector<ActionType>> get();
+};
+
+// scores actions and keeps them if they beat the incumbent; true when they did
+bool Incumbent::publish(const Context& ctx, const vector<vector<ActionType>>& actions) {
+    const long long score = common::score(ctx.in, actions);
+    if(score >= bound()) {
+        return false;
+    }
+    lock_guard<mutex> lock(mtx);
+    if(score >= best_score.load(memory_order_relaxed)) {
+        return false;
+    }
+    best = actions;
+    owner = ctx.name;
+    best_score.store(score, memory_order_release);
+    LOG_INFO("incumbent = " << score << " (" << owner << ")");
+    return true;
+}
+
+bool Incumbent::publish(const Context& ctx, const PackedActions& actions) {
+    return publish(ctx, actions.unpack());
+}
+
+vector<vector<ActionType>> Incumbent::get() {
+    lock_guard<mutex> lock(mtx);
+    return best;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __ASSIGNMENT_HPP__
+#define __ASSIGNMENT_HPP__
+
+#include <vector>
+#include <limits>
+#include <cassert>
+
+using namespace std;
+
+// minimum-cost assignment of every row to a distinct column (hungarian method with
+// potentials, O(rows^2 * cols)). needs rows <= cols; res[r] is the column of row r.
+vector<int> min_cost_assignment(const vector<vector<long long>>& cost) {
+    const int rows = cost.size();
+    if(rows == 0) {
+        return {};
+    }
+    const int cols = cost[0].size();
+    assert(rows <= cols);
+    constexpr long long inf = numeric_limits<long long>::max() / 4;
+    // 1-indexed; column 0 is a sentinel holding the row being inserted
+    vector<long long> u(rows+1, 0), v(cols+1, 0);
+    vector<int> match(cols+1, 0), way(cols+1, 0);
+    for(int r = 1; r <= rows; r++) {
+        match[0] = r;
+        int c0 = 0;
+        vector<long long> min_slack(cols+1, inf);
+        vector<bool> used(cols+1, false);
+        do {
+            used[c0] = true;
+            const int r0 = match[c0];
+            long long delta = inf;
+            int c1 = 0;
+            for(int c = 1; c <= cols; c++) {
+                if(used[c]) {
+                    continue;
+                }
+                const long long slack = cost[r0-1][c-1] - u[r0] - v[c];
+                if(slack < min_slack[c]) {
+                    min_slack[c] = slack;
+                    way[c] = c0;
+                }
+                if(min_slack[c] < delta) {
+                    delta = min_slack[c];
+                    c1 = c;
+                }
+            }
+            for(int c = 0; c <= cols; c++) {
+                if(used[c]) {
+                    u[match[c]] += delta;
+                    v[c] -= delta;
+                } else {
+                    min_slack[c] -= delta;
+                }
+            }
+            c0 = c1;
+        } while(match[c0] != 0);
+        // flip the augmenting path
+        do {
+            const int c1 = way[c0];
+            match[c0] = match[c1];
+            c0 = c1;
+        } while(c0 != 0);
+    }
+    vector<int> res(rows, -1);
+    for(int c = 1; c <= cols; c++) {
+        if(match[c] != 0) {
+            res[match[c]-1] = c-1;
+        }
+    }
+    return res;
+}
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef __BATCH_HPP__
+#define __BATCH_HPP__
+
+#include "common.hpp"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// structure-of-arrays checker: `size` independent terminals advanced in lockstep, each
+// update2 validated the way Terminal::referee2 validates it. it is for checking many
+// candidate trajectories at once, not a faster simulator: per lane-turn its AVX2 update2
+// is about twice as fast as referee2 but slower than the unchecked Terminal::update2
+// (bench: BatchTerminal::update2 ~24 ns, referee2 ~36-54 ns, update2 ~14-19 ns).
+// per-crane / per-cell / per-row columns are indexed [x*size + lane].
+// only the physical state is mirrored (cranes, containers, queues, collected);
+// the solver-side task fields of Crane are not.
+// an illegal action freezes its lane just before that update2 and is reported in
+// error / error_turn / error_crane instead of asserting.
+// update2 runs 8 lanes per AVX2 instruction when built with -mavx2 and falls back to
+// update2_scalar otherwise; update1 and update3 only touch a few cells per lane and stay
+// scalar. check.cpp compares both update2 paths against Terminal::referee2.
+struct BatchTerminal {
+    static constexpr int width = 8;                 // lanes per AVX2 register
+    static constexpr uint32_t in_mask = 0x108421;   // cells (i, 0)
+    static constexpr uint32_t out_mask = in_mask << (n-1);
+    int size;                                       // number of lanes, multiple of width
+    int turn_count;
+    vector<uint32_t> crane_mask;
+    vector<uint32_t> container_mask;
+    vector<uint32_t> hold_mask;                     // cells of cranes holding a container
+    vector<int32_t> crane_i, crane_j;
+    vector<int32_t> crane_exist;
+    vector<int32_t> crane_container;                // -1 if none
+    vector<int8_t> container_id;                    // [cell], -1 if empty
+    vector<int8_t> queue;                           // [i*n+k]
+    vector<int8_t> queue_head;                      // [i]
+    vector<int8_t> collected, collected_row;        // [k]
+    vector<int8_t> collected_count;
+    vector<int8_t> error;                           // SimError, ERR_NONE while the lane is alive
+    vector<int32_t> error_turn;
+    vector<int8_t> error_crane;
+    void init(int lanes, const Input&);
+    void load(int lane, const Terminal&);
+    void store(int lane, Terminal&) const;
+    void update1();
+    void update2(const int8_t* actions);            // actions[k*size + lane] holds an ActionType
+    void update2_scalar(const int8_t* actions);
+    void update3();
+    void update2_lane(int lane, const int8_t* actions);
+#if defined(__AVX2__)
+    void update2_avx2(int base, const int8_t* actions);
+#endif
+    void apply(int lane, int k, ActionType act);
+    void fail(int lane, SimError err, int k);
+    bool alive(int lane) const { return error[lane] == SimError::ERR_NONE; }
+};
+
+void BatchTerminal::init(int lanes, const Input& in) {
+    size = (lanes + width - 1) / width * width;
+    turn_count = 0;
+    crane_mask.assign(size, 0);
+    container_mask.assign(size, 0);
+    hold_mask.assign(size, 0);
+    crane_i.assign(n*size, 0);
+    crane_j.assign(n*size, 0);
+    crane_exist.assign(n*size, 0);
+    crane_container.assign(n*size, -1);
+    container_id.assign(n*n*size, -1);
+    queue.assign(n*n*size, -1);
+    queue_head.assign(n*size, 0);
+    collected.assign(n*n*size, -1);
+    collected_row.assign(n*n*size, -1);
+    collected_count.assign(size, 0);
+    error.assign(size, SimError::ERR_NONE);
+    error_turn.assign(size, -1);
+    error_crane.assign(size, -1);
+    Terminal term;
+    term.init(in);
+    for(int lane = 0; lane < size; lane++) {
+        load(lane, term);
+    }
+}
+
+void BatchTerminal::load(int lane, const Terminal& term) {
+    crane_mask[lane] = term.crane_mask;
+    container_mask[lane] = term.container_mask;
+    hold_mask[lane] = 0;
+    for(int k = 0; k < n; k++) {
+        const Crane& c = term.cranes[k];
+        crane_i[k*size+lane] = c.i;
+        crane_j[k*size+lane] = c.j;
+        crane_exist[k*size+lane] = c.exist;
+        crane_container[k*size+lane] = c.container;
+        if(c.exist && c.container != -1) {
+            hold_mask[lane] |= 1u << (c.i*n+c.j);
+        }
+    }
+    for(int cell = 0; cell < n*n; cell++) {
+        container_id[cell*size+lane] = term.container_id[cell];
+        collected[cell*size+lane] = term.collected[cell];
+        collected_row[cell*size+lane] = term.collected_row[cell];
+    }
+    for(int i = 0; i < n; i++) {
+        for(int k = 0; k < n; k++) {
+            queue[(i*n+k)*size+lane] = term.queue[i][k];
+        }
+        queue_head[i*size+lane] = term.queue_head[i];
+    }
+    collected_count[lane] = term.collected_count;
+    error[lane] = SimError::ERR_NONE;
+    error_turn[lane] = -1;
+    error_crane[lane] = -1;
+}
+
+void BatchTerminal::store(int lane, Terminal& term) const {
+    // solver-side fields of term.cranes are left untouched
+    term.turn_count = turn_count;
+    term.crane_mask = crane_mask[lane];
+    term.container_mask = container_mask[lane];
+    for(int k = 0; k < n; k++) {
+        Crane& c = term.cranes[k];
+        c.i = crane_i[k*size+lane];
+        c.j = crane_j[k*size+lane];
+        c.exist = crane_exist[k*size+lane];
+        c.container = crane_container[k*size+lane];
+    }
+    for(int cell = 0; cell < n*n; cell++) {
+        term.container_id[cell] = container_id[cell*size+lane];
+        term.collected[cell] = collected[cell*size+lane];
+        term.collected_row[cell] = collected_row[cell*size+lane];
+    }
+    for(int i = 0; i < n; i++) {
+        for(int k = 0; k < n; k++) {
+            term.queue[i][k] = queue[(i*n+k)*size+lane];
+        }
+        term.queue_head[i] = queue_head[i*size+lane];
+    }
+    term.collected_count = collected_count[lane];
+    memset(term.out_count, 0, sizeof(term.out_count));
+    for(int k = 0; k < term.collected_count; k++) {
+        term.out_count[term.collected_row[k]]++;
+    }
+    term.hash = term.calc_hash();
+}
+
+void BatchTerminal::update1() {
+    turn_count++;
+    for(int lane = 0; lane < size; lane++) {
+        if(!alive(lane)) {
+            continue;
+        }
+        for(uint32_t mask = in_mask & ~container_mask[lane] & ~hold_mask[lane]; mask; mask &= mask - 1) {
+            const int cell = countr_zero(mask);
+            const int i = cell / n;
+            int8_t& head = queue_head[i*size+lane];
+            if(head == n) {
+                continue;
+            }
+            container_id[cell*size+lane] = queue[(i*n+head)*size+lane];
+            head++;
+            container_mask[lane] |= 1u << cell;
+        }
+    }
+}
+
+void BatchTerminal::update3() {
+    for(int lane = 0; lane < size; lane++) {
+        if(!alive(lane)) {
+            continue;
+        }
+        for(uint32_t mask = out_mask & container_mask[lane]; mask; mask &= mask - 1) {
+            const int cell = countr_zero(mask);
+            int8_t& cnt = collected_count[lane];
+            collected[cnt*size+lane] = container_id[cell*size+lane];
+            collected_row[cnt*size+lane] = cell / n;
+            cnt++;
+            container_id[cell*size+lane] = -1;
+        }
+        container_mask[lane] &= ~out_mask;
+    }
+}
+
+void BatchTerminal::update2(const int8_t* actions) {
+#if defined(__AVX2__)
+    for(int base = 0; base < size; base += width) {
+        update2_avx2(base, actions);
+    }
+#else
+    update2_scalar(actions);
+#endif
+}
+
+void BatchTerminal::update2_scalar(const int8_t* actions) {
+    for(int lane = 0; lane < size; lane++) {
+        update2_lane(lane, actions);
+    }
+}
+
+void BatchTerminal::fail(int lane, SimError err, int k) {
+    error[lane] = err;
+    error_turn[lane] = turn_count;
+    error_crane[lane] = k;
+}
+
+// catch / release / bomb of an already validated action
+void BatchTerminal::apply(int lane, int k, ActionType act) {
+    const int cell = crane_i[k*size+lane]*n + crane_j[k*size+lane];
+    int32_t& held = crane_container[k*size+lane];
+    if(act == ActionType::CATCH) {
+        held = container_id[cell*size+lane];
+        container_id[cell*size+lane] = -1;
+        container_mask[lane] &= ~(1u << cell);
+    } else if(act == ActionType::RELEASE) {
+        container_id[cell*size+lane] = held;
+        container_mask[lane] |= 1u << cell;
+        held = -1;
+    } else if(act == ActionType::BOMB) {
+        crane_exist[k*size+lane] = 0;
+    }
+}
+
+// checks run crane by crane and the first failure wins; update2_avx2 must keep the same order.
+// containers are tested against the start-of-turn mask, which matches Terminal::update2
+// since only the crane standing on a cell can catch or release there.
+void BatchTerminal::update2_lane(int lane, const int8_t* actions) {
+    if(!alive(lane)) {
+        return;
+    }
+    int old_cell[n], new_cell[n];
+    bool occupy[n];
+    uint32_t next_crane_mask = 0;
+    uint32_t next_hold_mask = 0;
+    for(int k = 0; k < n; k++) {
+        const ActionType act = (ActionType)actions[k*size+lane];
+        const bool exist = crane_exist[k*size+lane];
+        const bool holding = crane_container[k*size+lane] != -1;
+        const int ci = crane_i[k*size+lane];
+        const int cj = crane_j[k*size+lane];
+        const auto [di, dj] = common::act2move(act);
+        const int ni = ci + di;
+        const int nj = cj + dj;
+        old_cell[k] = ci*n + cj;
+        new_cell[k] = ni*n + nj;
+        occupy[k] = exist && act != ActionType::BOMB;
+        SimError err = SimError::ERR_NONE;
+        if(!exist) {
+            if(act != ActionType::DESTROYED) err = SimError::ERR_DESTROYED_CRANE;
+        } else if(act == ActionType::DESTROYED) {
+            err = SimError::ERR_DESTROYED_ACTION;
+        } else if(ni < 0 || nj < 0 || ni >= n || nj >= n) {
+            err = SimError::ERR_OUT_OF_GRID;
+        }
+        for(int m = 0; m < k && err == SimError::ERR_NONE; m++) {
+            if(!occupy[k] || !occupy[m]) continue;
+            if(new_cell[k] == new_cell[m]) err = SimError::ERR_COLLISION;
+            else if(new_cell[k] == old_cell[m] && new_cell[m] == old_cell[k]) err = SimError::ERR_SWAP;
+        }
+        if(err == SimError::ERR_NONE && exist) {
+            const bool moved = di != 0 || dj != 0;
+            const bool on_container = container_mask[lane] >> old_cell[k] & 1;
+            if(k != 0 && moved && holding && (container_mask[lane] >> new_cell[k] & 1)) err = SimError::ERR_SMALL_OVER_CONTAINER;
+            else if(act == ActionType::CATCH && !on_container) err = SimError::ERR_CATCH_EMPTY;
+            else if(act == ActionType::CATCH && holding) err = SimError::ERR_CATCH_HOLDING;
+            else if(act == ActionType::RELEASE && !holding) err = SimError::ERR_RELEASE_EMPTY;
+            else if(act == ActionType::RELEASE && on_container) err = SimError::ERR_RELEASE_OCCUPIED;
+            else if(act == ActionType::BOMB && holding) err = SimError::ERR_BOMB_HOLDING;
+        }
+        if(err != SimError::ERR_NONE) {
+            fail(lane, err, k);
+            return;
+        }
+        if(occupy[k]) {
+            next_crane_mask |= 1u << new_cell[k];
+            if((holding && act != ActionType::RELEASE) || act == ActionType::CATCH) {
+                next_hold_mask |= 1u << new_cell[k];
+            }
+        }
+    }
+    for(int k = 0; k < n; k++) {
+        crane_i[k*size+lane] = new_cell[k] / n;
+        crane_j[k*size+lane] = new_cell[k] % n;
+        apply(lane, k, (ActionType)actions[k*size+lane]);
+    }
+    crane_mask[lane] = next_crane_mask;
+    hold_mask[lane] = next_hold_mask;
+}
+
+#if defined(__AVX2__)
+void BatchTerminal::update2_avx2(int base, const int8_t* actions) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i none = _mm256_set1_epi32(-1);
+    const __m256i last = _mm256_set1_epi32(n-1);
+    auto load8 = [](const int8_t* p) { return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)p)); };
+    auto load32 = [](const void* p) { return _mm256_loadu_si256((const __m256i*)p); };
+    auto is = [](__m256i v, int x) { return _mm256_cmpeq_epi32(v, _mm256_set1_epi32(x)); };
+    auto has_bit = [&](__m256i mask, __m256i cell) {
+        return _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(mask, _mm256_sllv_epi32(one, cell)), zero), none);
+    };
+
+    const __m256i live = is(load8(&error[base]), SimError::ERR_NONE);
+    if(_mm256_testz_si256(live, live)) {
+        return;
+    }
+    const __m256i cmask = load32(&container_mask[base]);
+    __m256i err = zero;
+    __m256i err_crane = none;
+    // record code for lanes where cond holds and nothing failed yet
+    auto check = [&](__m256i cond, SimError code, int k) {
+        cond = _mm256_andnot_si256(_mm256_xor_si256(is(err, SimError::ERR_NONE), none), cond);
+        err = _mm256_blendv_epi8(err, _mm256_set1_epi32(code), cond);
+        err_crane = _mm256_blendv_epi8(err_crane, _mm256_set1_epi32(k), cond);
+    };
+
+    __m256i act[n], new_i[n], new_j[n], old_cell[n], new_cell[n], occupy[n];
+    __m256i next_crane_mask = zero;
+    __m256i next_hold_mask = zero;
+    for(int k = 0; k < n; k++) {
+        act[k] = load8(&actions[k*size+base]);
+        const __m256i exist = is(load32(&crane_exist[k*size+base]), 1);
+        const __m256i holding = _mm256_xor_si256(is(load32(&crane_container[k*size+base]), -1), none);
+        const __m256i ci = load32(&crane_i[k*size+base]);
+        const __m256i cj = load32(&crane_j[k*size+base]);
+        const __m256i di = _mm256_sub_epi32(is(act[k], ActionType::UP), is(act[k], ActionType::DOWN));
+        const __m256i dj = _mm256_sub_epi32(is(act[k], ActionType::LEFT), is(act[k], ActionType::RIGHT));
+        new_i[k] = _mm256_add_epi32(ci, di);
+        new_j[k] = _mm256_add_epi32(cj, dj);
+        old_cell[k] = _mm256_add_epi32(_mm256_mullo_epi32(ci, _mm256_set1_epi32(n)), cj);
+        new_cell[k] = _mm256_add_epi32(_mm256_mullo_epi32(new_i[k], _mm256_set1_epi32(n)), new_j[k]);
+        occupy[k] = _mm256_andnot_si256(is(act[k], ActionType::BOMB), exist);
+
+        check(_mm256_andnot_si256(_mm256_or_si256(exist, is(act[k], ActionType::DESTROYED)), none), SimError::ERR_DESTROYED_CRANE, k);
+        check(_mm256_and_si256(exist, is(act[k], ActionType::DESTROYED)), SimError::ERR_DESTROYED_ACTION, k);
+        const __m256i oob = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(zero, new_i[k]), _mm256_cmpgt_epi32(new_i[k], last)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(zero, new_j[k]), _mm256_cmpgt_epi32(new_j[k], last)));
+        check(_mm256_and_si256(exist, oob), SimError::ERR_OUT_OF_GRID, k);
+        for(int m = 0; m < k; m++) {
+            const __m256i both = _mm256_and_si256(occupy[k], occupy[m]);
+            const __m256i same = _mm256_cmpeq_epi32(new_cell[k], new_cell[m]);
+            const __m256i cross = _mm256_and_si256(_mm256_cmpeq_epi32(new_cell[k], old_cell[m]), _mm256_cmpeq_epi32(new_cell[m], old_cell[k]));
+            check(_mm256_and_si256(both, same), SimError::ERR_COLLISION, k);
+            check(_mm256_and_si256(both, cross), SimError::ERR_SWAP, k);
+        }
+        const __m256i moved = _mm256_xor_si256(_mm256_cmpeq_epi32(new_cell[k], old_cell[k]), none);
+        const __m256i on_container = has_bit(cmask, old_cell[k]);
+        const __m256i is_catch = _mm256_and_si256(exist, is(act[k], ActionType::CATCH));
+        const __m256i is_release = _mm256_and_si256(exist, is(act[k], ActionType::RELEASE));
+        if(k != 0) {
+            check(_mm256_and_si256(_mm256_and_si256(exist, moved), _mm256_and_si256(holding, has_bit(cmask, new_cell[k]))),
+                SimError::ERR_SMALL_OVER_CONTAINER, k);
+        }
+        check(_mm256_andnot_si256(on_container, is_catch), SimError::ERR_CATCH_EMPTY, k);
+        check(_mm256_and_si256(is_catch, holding), SimError::ERR_CATCH_HOLDING, k);
+        check(_mm256_andnot_si256(holding, is_release), SimError::ERR_RELEASE_EMPTY, k);
+        check(_mm256_and_si256(is_release, on_container), SimError::ERR_RELEASE_OCCUPIED, k);
+        check(_mm256_and_si256(_mm256_and_si256(exist, is(act[k], ActionType::BOMB)), holding), SimError::ERR_BOMB_HOLDING, k);
+
+        const __m256i bit = _mm256_and_si256(occupy[k], _mm256_sllv_epi32(one, new_cell[k]));
+        next_crane_mask = _mm256_or_si256(next_crane_mask, bit);
+        const __m256i hold_after = _mm256_or_si256(_mm256_andnot_si256(is_release, holding), is_catch);
+        next_hold_mask = _mm256_or_si256(next_hold_mask, _mm256_and_si256(bit, hold_after));
+    }
+
+    const __m256i ok = _mm256_and_si256(live, is(err, SimError::ERR_NONE));
+    const int ok_bits = _mm256_movemask_ps(_mm256_castsi256_ps(ok));
+    const int fail_bits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(ok, live)));
+    for(int k = 0; k < n; k++) {
+        _mm256_maskstore_epi32(&crane_i[k*size+base], ok, new_i[k]);
+        _mm256_maskstore_epi32(&crane_j[k*size+base], ok, new_j[k]);
+        const __m256i special = _mm256_or_si256(_mm256_or_si256(is(act[k], ActionType::CATCH), is(act[k], ActionType::RELEASE)), is(act[k], ActionType::BOMB));
+        const __m256i special_exist = _mm256_and_si256(special, is(load32(&crane_exist[k*size+base]), 1));
+        for(int bits = ok_bits & _mm256_movemask_ps(_mm256_castsi256_ps(special_exist)); bits; bits &= bits - 1) {
+            const int lane = base + countr_zero((unsigned)bits);
+            apply(lane, k, (ActionType)actions[k*size+lane]);
+        }
+    }
+    _mm256_maskstore_epi32((int*)&crane_mask[base], ok, next_crane_mask);
+    _mm256_maskstore_epi32((int*)&hold_mask[base], ok, next_hold_mask);
+    if(fail_bits) {
+        alignas(32) int32_t err_buf[width], crane_buf[width];
+        _mm256_store_si256((__m256i*)err_buf, err);
+        _mm256_store_si256((__m256i*)crane_buf, err_crane);
+        for(int bits = fail_bits; bits; bits &= bits - 1) {
+            const int l = countr_zero((unsigned)bits);
+            fail(base + l, (SimError)err_buf[l], crane_buf[l]);
+        }
+    }
+}
+#endif
+
+#endif
@@ -0,0 +1,336 @@
+// microbenchmarks for the simulator and the solvers on a fixed set of seeds.
+//   g++ -std=c++20 -O2 -mavx2 -pthread -DAHC_LOG_LEVEL=1 bench.cpp -o bench && ./bench [reps] [filter]
+// every benchmark runs reps repetitions over the same recorded states and reports
+// mean / stddev / min ns per op and heap allocations per op. "copy" rows are the
+// cost of restoring a snapshot, which the update rows include. BatchTerminal rows are
+// per lane-turn and compare with Terminal::referee2, not the unchecked update2; without
+// -mavx2 its update2 is the scalar path.
+#include "common.hpp"
+#include "batch.hpp"
+#include "solver_000.hpp"
+#include "solver_001.hpp"
+#include "solver_002.hpp"
+#include "generator.hpp"
+#include "toki.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+using namespace std;
+
+thread_local Input in;
+extern Timer toki;
+
+// counts heap allocations of the whole process
+atomic<long long> alloc_counter(0);
+
+// malloc/free on purpose: the counter must not recurse into operator new
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(size_t size) {
+    alloc_counter.fetch_add(1, memory_order_relaxed);
+    if(void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace bench {
+
+using sovler_001::Dispatcher;
+using sovler_001::TaskRegistry;
+
+constexpr int seed_count = 8;
+constexpr uint64_t seeds[seed_count] = {0, 1, 2, 3, 4, 5, 6, 7};
+// seconds per solver_002::solve
+constexpr double solver_002_budget = 0.05;
+
+// states seen by solver_001's greedy run, one entry per dispatched turn
+struct Recording {
+    vector<Input> inputs;
+    vector<Terminal> before_update1, before_update2, before_update3;
+    vector<vector<ActionType>> actions;
+    vector<Terminal> before_update_cr_tasks;
+    vector<TaskRegistry> tasks;             // right before update_cr_tasks
+    vector<vector<int>> next_c;
+    vector<Dispatcher> planned;             // right after plan_paths
+    void record(const Input& input);
+};
+
+void Recording::record(const Input& input) {
+    inputs.push_back(input);
+    mt19937 engine(0);
+    Dispatcher d;
+    d.init(input, false);
+    while(d.term.turn_count < MAX_TURN && !d.finished()) {
+        // same steps as Dispatcher::begin_turn / end_turn, with snapshots in between
+        const vector<int> next = d.next_containers();
+        before_update1.push_back(d.term);
+        d.term.update1();
+        before_update_cr_tasks.push_back(d.term);
+        tasks.push_back(d.cr_tasks);
+        next_c.push_back(next);
+        d.update_cr_tasks(next);
+        d.assign_free_cranes();
+        d.plan_paths(engine);
+        d.update_crane_reserved();
+        planned.push_back(d);
+        vector<ActionType> acts(n);
+        for(int i = 0; i < n; i++) {
+            acts[i] = sovler_001::get_next_action(i, d.planner.next_cell(i), d.stay_count[i], d.reserved_cells(), d.term, d.res);
+            const auto [di, dj] = common::act2move(acts[i]);
+            d.stay_count[i] = (di == 0 && dj == 0 ? d.stay_count[i] + 1 : 0);
+        }
+        before_update2.push_back(d.term);
+        d.term.update2(acts);
+        before_update3.push_back(d.term);
+        d.term.update3();
+        d.res.push_back(acts);
+        actions.push_back(acts);
+    }
+}
+
+struct Result {
+    double mean, stddev, min;
+    double allocs;
+};
+
+// runs body reps times; body performs ops operations per call
+Result measure(int reps, long long ops, const function<void()>& body) {
+    body();     // warm up caches and lazily built tables
+    vector<double> ns(reps);
+    const long long alloc_start = alloc_counter.load();
+    for(int r = 0; r < reps; r++) {
+        const double start = toki.gettime();
+        body();
+        ns[r] = (toki.gettime() - start) * 1e9 / ops;
+    }
+    const long long allocs = alloc_counter.load() - alloc_start;
+    Result res{0, 0, ns[0], (double)allocs / reps / ops};
+    for(const double x : ns) {
+        res.mean += x / reps;
+        res.min = min(res.min, x);
+    }
+    for(const double x : ns) {
+        res.stddev += (x - res.mean) * (x - res.mean) / max(1, reps - 1);
+    }
+    res.stddev = sqrt(res.stddev);
+    return res;
+}
+
+// keeps the optimizer from dropping benchmarked work
+volatile uint64_t sink;
+template<class T> void escape(T& x) { asm volatile("" : : "r"(&x) : "memory"); }
+
+void report(const string& name, const Result& r) {
+    printf("%-28s %12.1f ns/op  +- %8.1f  min %12.1f  %8.2f allocs/op\n", name.c_str(), r.mean, r.stddev, r.min, r.allocs);
+}
+
+} // namespace bench
+
+int main(int argc, char** argv) {
+
+    using namespace bench;
+    toki.init();
+    const int reps = argc > 1 ? max(2, atoi(argv[1])) : 20;
+    const string filter = argc > 2 ? argv[2] : "";
+    // solvers log to cerr; benchmark them without the terminal in the loop
+    cerr.setstate(ios::badbit);
+
+    Recording rec;
+    for(const uint64_t seed : seeds) {
+        rec.record(generator::generate(seed));
+    }
+    const long long turns = rec.actions.size();
+    printf("%d seeds, %lld recorded turns, %d reps\n", seed_count, turns, reps);
+
+    auto run = [&](const string& name, long long ops, const function<void()>& body) {
+        if(name.find(filter) != string::npos) {
+            report(name, measure(reps, ops, body));
+        }
+    };
+
+    {
+        Input scratch;
+        run("generator::generate", 1 << 16, [&]() {
+            for(uint64_t seed = 0; seed < (1 << 16); seed++) {
+                generator::generate(seed, scratch);
+                escape(scratch.a[0][0]);
+            }
+        });
+    }
+    run("Terminal::init", seed_count, [&]() {
+        for(const Input& input : rec.inputs) {
+            Terminal term;
+            term.init(input);
+            escape(term);
+        }
+    });
+    run("Terminal copy", turns, [&]() {
+        for(long long t = 0; t < turns; t++) {
+            Terminal term = rec.before_update1[t];
+            escape(term);
+        }
+    });
+    run("Terminal::update1", turns, [&]() {
+        for(long long t = 0; t < turns; t++) {
+            Terminal term = rec.before_update1[t];
+            term.update1();
+            escape(term);
+        }
+    });
+    run("Terminal::update2", turns, [&]() {
+        for(long long t = 0; t < turns; t++) {
+            Terminal term = rec.before_update2[t];
+            term.update2(rec.actions[t]);
+            escape(term);
+        }
+    });
+    // the checked step, which is what BatchTerminal::update2 does per lane
+    run("Terminal::referee2", turns, [&]() {
+        for(long long t = 0; t < turns; t++) {
+            Terminal term = rec.before_update2[t];
+            sink = sink + term.referee2(rec.actions[t]).error;
+            escape(term);
+        }
+    });
+    run("Terminal::update3", turns, [&]() {
+        for(long long t = 0; t < turns; t++) {
+            Terminal term = rec.before_update3[t];
+            term.update3();
+            escape(term);
+        }
+    });
+    {
+        // one trial turn and back again, by restoring a copy or by rolling the journal back
+        Terminal term, saved;
+        run("turn + restore copy", turns, [&]() {
+            for(long long t = 0; t < turns; t++) {
+                term = rec.before_update1[t];
+                saved = term;
+                term.update1();
+                term.update2(rec.actions[t]);
+                term.update3();
+                term = saved;
+                escape(term);
+            }
+        });
+        UndoLog log;
+        run("turn + rollback", turns, [&]() {
+            for(long long t = 0; t < turns; t++) {
+                term = rec.before_update1[t];
+                const int mark = log.mark();
+                term.update1(&log);
+                term.update2(rec.actions[t], &log);
+                term.update3(&log);
+                term.rollback(log, mark);
+                escape(term);
+            }
+        });
+    }
+    {
+        // the recorded turns before update2, BatchTerminal::width lanes at a time
+        vector<BatchTerminal> groups;
+        vector<vector<int8_t>> group_actions;
+        for(long long t = 0; t + BatchTerminal::width <= turns; t += BatchTerminal::width) {
+            BatchTerminal batch;
+            batch.init(BatchTerminal::width, rec.inputs[0]);
+            vector<int8_t> acts(n * batch.size);
+            for(int lane = 0; lane < batch.size; lane++) {
+                batch.load(lane, rec.before_update2[t + lane]);
+                for(int k = 0; k < n; k++) {
+                    acts[k*batch.size + lane] = rec.actions[t + lane][k];
+                }
+            }
+            batch.turn_count = rec.before_update2[t].turn_count;
+            groups.push_back(batch);
+            group_actions.push_back(acts);
+        }
+        const long long lane_turns = groups.size() * BatchTerminal::width;
+        BatchTerminal scratch = groups[0];
+        run("BatchTerminal copy", lane_turns, [&]() {
+            for(const BatchTerminal& batch : groups) {
+                scratch = batch;
+                escape(scratch);
+            }
+        });
+        run("BatchTerminal::update2", lane_turns, [&]() {
+            for(size_t g = 0; g < groups.size(); g++) {
+                scratch = groups[g];
+                scratch.update2(group_actions[g].data());
+                escape(scratch);
+            }
+        });
+        run("BatchTerminal::update2_scalar", lane_turns, [&]() {
+            for(size_t g = 0; g < groups.size(); g++) {
+                scratch = groups[g];
+                scratch.update2_scalar(group_actions[g].data());
+                escape(scratch);
+            }
+        });
+    }
+    run("get_next_action", turns * n, [&]() {
+        for(const Dispatcher& d : rec.planned) {
+            for(int i = 0; i < n; i++) {
+                sink = sink + (int)sovler_001::get_next_action(i, d.planner.next_cell(i), d.stay_count[i], d.reserved_cells(), d.term, d.res);
+            }
+        }
+    });
+    {
+        Dispatcher scratch;
+        scratch.init(rec.inputs[0], false);
+        run("TaskRegistry copy", turns, [&]() {
+            for(long long t = 0; t < turns; t++) {
+                scratch.cr_tasks = rec.tasks[t];
+                escape(scratch);
+            }
+        });
+        run("update_cr_tasks", turns, [&]() {
+            for(long long t = 0; t < turns; t++) {
+                scratch.term = rec.before_update_cr_tasks[t];
+                scratch.cr_tasks = rec.tasks[t];
+                scratch.update_cr_tasks(rec.next_c[t]);
+                escape(scratch);
+            }
+        });
+    }
+
+    // whole runs, one op per seed. solver_002 widens its beam to fill whatever budget it is
+    // given, so it runs with a fixed one; its row shows how much of that budget it uses.
+    // solver_003 anneals until its deadline and is not measured here
+    run("solver_000::solve", seed_count, [&]() {
+        for(const Input& input : rec.inputs) {
+            in = input;
+            sink = sink + solver_000::solve()[0].size();
+        }
+    });
+    run("sovler_001::solve", seed_count, [&]() {
+        for(const Input& input : rec.inputs) {
+            in = input;
+            sink = sink + sovler_001::solve()[0].size();
+        }
+    });
+    {
+        Incumbent incumbent;
+        run("sovler_001::run_restart", seed_count, [&]() {
+            for(const Input& input : rec.inputs) {
+                in = input;
+                sink = sink + sovler_001::run_restart(1, 1, incumbent).size();
+            }
+        });
+    }
+    run("solver_002::solve (50 ms)", seed_count, [&]() {
+        for(const Input& input : rec.inputs) {
+            in = input;
+            Incumbent incumbent;
+            const Context ctx{in, 1, "bench"};
+            solver_002::solve(ctx, toki.elapsed() + solver_002_budget, incumbent);
+            sink = sink + incumbent.bound();
+        }
+    });
+
+}
@@ -0,0 +1,327 @@
+// self-checks of the simulator and the solvers; exits non-zero if any of them fails.
+//   g++ -std=c++20 -O2 -mavx2 -pthread -DAHC_LOG_LEVEL=1 check.cpp -o check && ./check [filter]
+// (without -mavx2 the BatchTerminal checks compare the scalar path twice)
+// every check is a plain function; main runs those whose name contains filter.
+#include "common.hpp"
+#include "batch.hpp"
+#include "generator.hpp"
+#include "solver_001.hpp"
+#include "solver_002.hpp"
+#include "trace.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <string>
+using namespace std;
+
+thread_local Input in;
+
+namespace check {
+
+int failures = 0;
+
+void expect(bool ok, const string& what) {
+    if(!ok) {
+        printf("  FAILED: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+// occupancy, hash and the crane records have to agree after any legal turn
+void expect_consistent(const Terminal& term, const string& what) {
+    uint32_t mask = 0;
+    for(const Crane& c : term.cranes) {
+        if(c.exist) {
+            mask |= 1u << (c.i*n + c.j);
+        }
+    }
+    expect(term.crane_mask == mask, what + ": crane_mask matches the cranes");
+    expect(term.hash == term.calc_hash(), what + ": hash matches calc_hash");
+}
+
+// a crane bombs while another one moves into its cell on the same turn, once with the
+// bombing crane after the mover (crane 1 bombs, crane 0 moves down) and once before it
+// (crane 1 bombs, crane 2 moves up)
+void step_bomb_and_move_in() {
+    for(const int mover : {0, 2}) {
+        Terminal term;
+        term.init(generator::generate(0));
+        term.update1();
+        vector<ActionType> acts(n, ActionType::WAIT);
+        acts[1] = ActionType::BOMB;
+        acts[mover] = (mover == 0 ? ActionType::DOWN : ActionType::UP);
+        const string what = "crane " + to_string(mover) + " moves into the cell of bombed crane 1";
+        expect(term.referee2(acts).ok(), what + ": legal");
+        expect(!term.cranes[1].exist, what + ": crane 1 is gone");
+        expect(term.has_crane(1, 0), what + ": (1, 0) is occupied");
+        expect(term.crane_at(1, 0) == mover, what + ": crane_at(1, 0) is the mover");
+        expect_consistent(term, what);
+    }
+}
+
+// DESTROYED is only an action of a bombed crane; a live crane given it is an error and
+// the turn is not applied
+void step_destroyed_on_live_crane() {
+    Terminal term;
+    term.init(generator::generate(0));
+    term.update1();
+    const Terminal before = term;
+    vector<ActionType> acts(n, ActionType::WAIT);
+    acts[2] = ActionType::DESTROYED;
+    const SimStatus status = term.referee2(acts);
+    expect(status.error == SimError::ERR_DESTROYED_ACTION && status.crane == 2, "rejected as ERR_DESTROYED_ACTION at crane 2");
+    expect(memcmp(&term, &before, sizeof(Terminal)) == 0, "state is untouched");
+    expect(term.cranes[2].exist, "crane 2 still exists");
+}
+
+// rows of different lengths are replayed up to the longest one; a crane past the end of
+// its row waits. crane 0 bombs on turn 1, so its row is the shortest
+void referee_ragged_rows() {
+    const Input input = generator::generate(0);
+    vector<vector<ActionType>> actions(n);
+    actions[0] = {ActionType::BOMB};
+    actions[1] = {ActionType::WAIT, ActionType::RIGHT, ActionType::RIGHT};
+    Terminal last;
+    expect(common::referee(input, actions, &last).ok(), "legal");
+    expect(last.turn_count == 3, "all 3 turns replayed");
+    expect(!last.cranes[0].exist, "crane 0 is gone");
+    expect(last.crane_at(1, 2) == 1, "crane 1 reached (1, 2)");
+    expect(last.crane_at(2, 0) == 2, "crane 2 waited at (2, 0)");
+    // an illegal action in the tail of a longer row is still found
+    actions[1] = {ActionType::WAIT, ActionType::WAIT, ActionType::LEFT};
+    const SimStatus status = common::referee(input, actions);
+    expect(status.error == SimError::ERR_OUT_OF_GRID && status.crane == 1 && status.turn == 3, "LEFT off the grid on turn 3 is found");
+}
+
+ActionType random_action(mt19937& engine) {
+    return engine() % 256 == 0 ? ActionType::BOMB : (ActionType)(engine() % (ActionType::WAIT + 1));
+}
+
+// random actions, picked crane by crane so that the turn is usually legal (check2 blames
+// the first crane that breaks a rule); one turn in 512 gets a fully random action instead,
+// so that the error reports get exercised too
+vector<ActionType> random_actions(const Terminal& term, mt19937& engine) {
+    vector<ActionType> acts(n);
+    for(int k = 0; k < n; k++) {
+        acts[k] = term.cranes[k].exist ? ActionType::WAIT : ActionType::DESTROYED;
+    }
+    for(int k = 0; k < n; k++) {
+        if(!term.cranes[k].exist) {
+            continue;
+        }
+        for(int attempt = 0; attempt < 16; attempt++) {
+            acts[k] = random_action(engine);
+            const SimStatus status = term.check2(acts.data());
+            if(status.ok() || status.crane > k) {
+                break;
+            }
+        }
+    }
+    if(engine() % 512 == 0) {
+        acts[engine() % n] = (ActionType)(engine() % (ActionType::DESTROYED + 1));
+    }
+    return acts;
+}
+
+// a journaled turn rolled back restores the state before it byte for byte: random turns
+// (illegal ones included, where referee2 leaves update1's changes to undo), then a roll
+// back to a random earlier mark every few turns
+void undo_rollback_restores() {
+    long long rollbacks = 0;
+    for(uint64_t seed = 0; seed < 8; seed++) {
+        const Input input = generator::generate(seed);
+        mt19937 engine(seed);
+        Terminal term;
+        term.init(input);
+        UndoLog log;
+        vector<Terminal> before;
+        vector<int> marks;
+        for(int t = 0; t < 400 && term.turn_count < MAX_TURN; t++) {
+            before.push_back(term);
+            marks.push_back(log.mark());
+            term.update1(&log);
+            if(term.referee2(random_actions(term, engine), &log).ok()) {
+                term.update3(&log);
+            } else {
+                term.rollback(log, marks.back());
+                before.pop_back();
+                marks.pop_back();
+            }
+            if(engine() % 16 == 0 && !before.empty()) {
+                const int k = engine() % before.size();
+                term.rollback(log, marks[k]);
+                const string what = "seed " + to_string(seed) + " turn " + to_string(t) + " back to turn " + to_string(before[k].turn_count);
+                expect(memcmp(&term, &before[k], sizeof(Terminal)) == 0, what + ": same state");
+                expect(log.mark() == marks[k], what + ": log cut at the mark");
+                before.resize(k);
+                marks.resize(k);
+                rollbacks++;
+            }
+        }
+    }
+    printf("  %lld rollbacks\n", rollbacks);
+}
+
+// BatchTerminal against Terminal::referee2, lane by lane, for the update2 path the build
+// selects and for update2_scalar: the same error at the same crane, or the same state
+void batch_matches_terminal() {
+    constexpr int lanes = 64;
+    constexpr int turns = 300;
+    long long lane_turns = 0, failed_lanes = 0;
+    for(const bool scalar : {false, true}) {
+        for(uint64_t seed = 0; seed < 8; seed++) {
+            const Input input = generator::generate(seed);
+            mt19937 engine(seed);
+            vector<Terminal> terms(lanes);
+            vector<bool> live(lanes, true);
+            BatchTerminal batch;
+            batch.init(lanes, input);
+            for(Terminal& term : terms) {
+                term.init(input);
+            }
+            vector<int8_t> acts(n * batch.size, ActionType::WAIT);
+            for(int t = 0; t < turns; t++) {
+                batch.update1();
+                vector<vector<ActionType>> lane_acts(lanes);
+                for(int lane = 0; lane < lanes; lane++) {
+                    terms[lane].update1();
+                    lane_acts[lane] = random_actions(terms[lane], engine);
+                    for(int k = 0; k < n; k++) {
+                        acts[k*batch.size + lane] = lane_acts[lane][k];
+                    }
+                }
+                if(scalar) {
+                    batch.update2_scalar(acts.data());
+                } else {
+                    batch.update2(acts.data());
+                }
+                batch.update3();
+                for(int lane = 0; lane < lanes; lane++) {
+                    if(!live[lane]) {
+                        continue;
+                    }
+                    const string what = string(scalar ? "scalar" : "update2") + " seed " + to_string(seed)
+                        + " lane " + to_string(lane) + " turn " + to_string(t);
+                    const SimStatus status = terms[lane].referee2(lane_acts[lane]);
+                    if(!status.ok()) {
+                        expect(batch.error[lane] == status.error && batch.error_crane[lane] == status.crane, what + ": same error");
+                        live[lane] = false;
+                        failed_lanes++;
+                        continue;
+                    }
+                    terms[lane].update3();
+                    lane_turns++;
+                    expect(batch.alive(lane), what + ": lane stays alive");
+                    Terminal stored = terms[lane];
+                    batch.store(lane, stored);
+                    if(memcmp(&stored, &terms[lane], sizeof(Terminal)) != 0) {
+                        expect(false, what + ": same state");
+                        live[lane] = false;
+                    }
+                }
+            }
+        }
+    }
+    printf("  %lld lane-turns, %lld lanes stopped by an illegal action\n", lane_turns, failed_lanes);
+}
+
+// the greedy dispatcher (run_restart r = 0) and its noisy restarts (r > 0) have to carry every
+// container out before MAX_TURN on generated inputs with a legal answer; a deadlock between
+// cranes used to run them to the limit, and a stuck small crane used to drop its container on
+// a cell another task was about to release onto
+void solver_001_finishes_generated() {
+    Incumbent incumbent;
+    for(uint64_t seed = 0; seed < 300; seed++) {
+        in = generator::generate(seed);
+        for(int r = 0; r < 8; r++) {
+            const vector<vector<ActionType>> actions = sovler_001::run_restart(12345 + seed, r, incumbent).unpack();
+            const string what = "seed " + to_string(seed) + " r " + to_string(r);
+            Terminal last;
+            expect(common::referee(in, actions, &last).ok(), what + ": legal");
+            expect(last.turn_count < MAX_TURN, what + ": finishes before MAX_TURN");
+            expect(common::score(in, actions) < 1000000, what + ": every container carried out");
+        }
+    }
+}
+
+// solver_002 stops once the incumbent bound says no later trajectory can win. the beam it
+// leaves behind was moved into the candidates, so it must not be published as a partial
+// answer; with a good incumbent given up front the beam is cut, and the incumbent stays as it was
+void solver_002_prunes_against_incumbent() {
+    for(uint64_t seed = 0; seed < 4; seed++) {
+        in = generator::generate(seed);
+        Incumbent incumbent;
+        const Context ctx{in, seed, "check"};
+        const vector<vector<ActionType>> greedy = sovler_001::run_restart(1, 0, incumbent).unpack();
+        incumbent.publish(ctx, greedy);
+        const long long bound = incumbent.bound();
+        solver_002::solve(ctx, toki.elapsed() + 0.5, incumbent);
+        const string what = "seed " + to_string(seed);
+        expect(incumbent.bound() <= bound, what + ": the bound does not get worse");
+        expect(common::referee(in, incumbent.get()).ok(), what + ": the incumbent is legal");
+        expect(common::score(in, incumbent.get()) == incumbent.bound(), what + ": the incumbent scores its bound");
+    }
+}
+
+// a trace survives save and load, and seeking through its snapshots ends where the referee
+// does. a trace with an illegal action does not load, and one edited in memory stops the
+// replay at that turn
+void trace_replay_checked() {
+    in = generator::generate(0);
+    Incumbent incumbent;
+    const vector<vector<ActionType>> actions = sovler_001::run_restart(1, 0, incumbent).unpack();
+    Terminal last;
+    expect(common::referee(in, actions, &last).ok(), "the answer is legal");
+    const string path = (filesystem::temp_directory_path() / "ahc_check_trace.bin").string();
+    expect(Trace::build(in, 0, actions, 16).save(path), "saved");
+    Trace trace;
+    expect(trace.load(path), "loaded");
+    filesystem::remove(path);
+    expect(trace.turns() == last.turn_count, "every turn recorded");
+    Replayer replayer;
+    replayer.init(trace);
+    expect(replayer.seek(trace.turns()).ok(), "replays to the end");
+    expect(replayer.term.turn_count == last.turn_count && replayer.term.hash == last.hash, "ends in the referee's state");
+    expect(replayer.seek(trace.turns() / 2).ok() && replayer.term.turn_count == trace.turns() / 2, "seeks back to the middle");
+    // crane 0 starts at (0, 0), so LEFT on turn 1 leaves the grid
+    trace.actions[0] = (trace.actions[0] & ~15u) | ActionType::LEFT;
+    expect(trace.save(path), "saved with an illegal action");
+    Trace illegal;
+    expect(!illegal.load(path), "a trace with an illegal action does not load");
+    filesystem::remove(path);
+    // no snapshot before turn 16, so this replays turn 1
+    replayer.init(trace);
+    const SimStatus status = replayer.seek(15);
+    expect(status.error == SimError::ERR_OUT_OF_GRID && status.turn == 1 && status.crane == 0, "LEFT off the grid on turn 1 is found");
+    expect(replayer.term.turn_count == 0, "the illegal turn is not applied");
+}
+
+} // namespace check
+
+int main(int argc, char** argv) {
+
+    using namespace check;
+    const string filter = argc > 1 ? argv[1] : "";
+    // solvers log to cerr; only the verdicts matter here
+    cerr.setstate(ios::badbit);
+
+    auto run = [&](const string& name, const function<void()>& body) {
+        if(name.find(filter) == string::npos) {
+            return;
+        }
+        const int before = failures;
+        body();
+        printf("%-32s %s\n", name.c_str(), failures == before ? "ok" : "FAILED");
+    };
+
+    run("step/bomb_and_move_in", step_bomb_and_move_in);
+    run("step/destroyed_on_live_crane", step_destroyed_on_live_crane);
+    run("referee/ragged_rows", referee_ragged_rows);
+    run("undo/rollback_restores", undo_rollback_restores);
+    run("batch/matches_terminal", batch_matches_terminal);
+    run("solver_001/finishes_generated", solver_001_finishes_generated);
+    run("solver_002/prunes_against_incumbent", solver_002_prunes_against_incumbent);
+    run("trace/replay_checked", trace_replay_checked);
+
+    return failures == 0 ? 0 : 1;
+}
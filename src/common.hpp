@@ -4,27 +4,27 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <memory>
-#include <queue>
 #include <cassert>
 #include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <type_traits>
+#include <random>
+#include "profile.hpp"
+#include "logger.hpp"
 
 using namespace std;
 
 constexpr int n = 5;
 constexpr int MAX_TURN = 10000;
 
-enum ObjectType {
-    CRANE,
-    CONTAINER,
-};
-
-enum CraneType {
+enum CraneType : int8_t {
     LARGE,
     SMALL,
 };
 
-enum CraneStatus {
+enum CraneStatus : int8_t {
     FREE,
     PRE_CATCH,
     CATCH_NOW,
@@ -44,65 +44,159 @@ enum ActionType {
     DESTROYED,
 };
 
-struct Object {
-    int i, j;
-    int id;
-    ObjectType obj_type;
-    Object(int i, int j, int id, ObjectType obj_type) : i(i), j(j), id(id), obj_type(obj_type) {}
-    virtual ~Object() = default;
+// reason an action could not be applied (first one found wins)
+enum SimError : int8_t {
+    ERR_NONE,
+    ERR_OUT_OF_GRID,
+    ERR_COLLISION,
+    ERR_SWAP,
+    ERR_SMALL_OVER_CONTAINER,
+    ERR_CATCH_EMPTY,
+    ERR_CATCH_HOLDING,
+    ERR_RELEASE_EMPTY,
+    ERR_RELEASE_OCCUPIED,
+    ERR_BOMB_HOLDING,
+    ERR_DESTROYED_CRANE,        // a bombed crane was given something other than DESTROYED
+    ERR_DESTROYED_ACTION,       // DESTROYED was given to a crane that still exists
 };
 
-struct Container : Object {
-    int out_i;
-    Container(int i, int j, int id, int out_i) : Object(i, j, id, ObjectType::CONTAINER), out_i(out_i) {}
+// outcome of a refereed step or replay; turn and crane locate the first illegal action
+struct SimStatus {
+    SimError error;
+    int turn;
+    int8_t crane;
+    bool ok() const { return error == SimError::ERR_NONE; }
 };
 
-struct Crane : Object {
+// trivially copyable crane state; id is the index in Terminal::cranes
+struct Crane {
+    int8_t i, j;
     CraneType crane_type;
-    shared_ptr<Container> container;
-    bool exist;
     CraneStatus status;
-    int catch_i, catch_j;
-    int release_i, release_j;
-    int prev_container_id;
-    Crane(int i, int j, int id, CraneType crane_type) : Object(i, j, id, ObjectType::CRANE), crane_type(crane_type), container(nullptr), exist(true), prev_container_id(-1) {} 
+    bool exist;
+    int8_t container;  // held container id, -1 if none
+    int8_t catch_i, catch_j;
+    int8_t release_i, release_j;
+    int8_t prev_container_id;
     void set_catch_and_release(int, int, int, int);
 };
 
 struct Input {
     vector<vector<int>> a;
-    void read();
+    void read(istream& is = cin);
+};
+
+// random keys for Terminal::hash, drawn from a fixed seed so hashes are reproducible
+struct Zobrist {
+    uint64_t crane[n][n*n];         // crane k standing on cell
+    uint64_t hold[n][n*n];          // crane k holding container id
+    uint64_t cell[n*n][n*n];        // container id lying on cell
+    uint64_t queue_head[n][n+1];    // arrival queue of row i popped head times
+    uint64_t out_count[n][n*n+1];   // outlet i received count containers
+    Zobrist();
+} zobrist;
+
+Zobrist::Zobrist() {
+    mt19937_64 engine(0x5eed);
+    for(auto& row : crane) for(auto& x : row) x = engine();
+    for(auto& row : hold) for(auto& x : row) x = engine();
+    for(auto& row : cell) for(auto& x : row) x = engine();
+    for(auto& row : queue_head) for(auto& x : row) x = engine();
+    for(auto& row : out_count) for(auto& x : row) x = engine();
+}
+
+struct Terminal;
+
+enum UndoType : int8_t {
+    UNDO_HEADER,     // turn_count, occupancy masks and hash at the start of an update
+    UNDO_CRANE,      // whole Crane record before it moved / caught / released
+    UNDO_CELL,       // container_id byte before a catch / release / arrival
+    UNDO_QUEUE_POP,  // a container left the arrival queue of row idx
+    UNDO_COLLECT,    // a container was carried out of outlet idx
+};
+
+struct UndoEntry {
+    UndoType type;
+    int8_t idx;
+    int8_t cell_id;
+    Crane crane;
+    int turn_count;
+    uint32_t crane_mask, container_mask;
+    uint64_t hash;
+};
+
+// journal of changes made by Terminal::update1/update2/update3.
+// take mark() before a trial turn and call Terminal::rollback to undo it. a depth-first
+// search keeps one Terminal and one log instead of a snapshot per depth; for a single
+// trial turn, restoring a copy is about twice as fast (bench: "turn + rollback").
+struct UndoLog {
+    vector<UndoEntry> entries;
+    int mark() const { return entries.size(); }
+    void clear() { entries.clear(); }
+    void record_header(const Terminal&);
+    void record_crane(const Terminal&, int k);
+    void record_cell(const Terminal&, int cell);
+    void record_queue_pop(int i);
+    void record_collect(int i);
 };
 
+// POD terminal state: bit (i*n+j) of each mask stands for cell (i, j).
+// Copy it by value (or memcpy); no heap memory is owned.
 struct Terminal {
     int turn_count;
-    vector<shared_ptr<Crane>> cranes;
-    vector<shared_ptr<Container>> containers;
-    vector<queue<shared_ptr<Container>>> container_queue;
-    vector<vector<shared_ptr<Crane>>> crane_pos;
-    vector<vector<shared_ptr<Container>>> container_pos;
-    vector<vector<shared_ptr<Container>>> collected_containers;
+    uint32_t crane_mask;
+    uint32_t container_mask;
+    int8_t container_id[n*n];       // container id on each cell, -1 if empty
+    Crane cranes[n];
+    int8_t queue[n][n];             // arrival order of each row
+    int8_t queue_head[n];
+    int8_t collected[n*n];          // carried-out containers in order (any outlet may receive up to n*n)
+    int8_t collected_row[n*n];      // outlet row of collected[k]
+    int8_t collected_count;
+    int8_t out_count[n];            // carried-out containers per outlet row
+    uint64_t hash;                  // Zobrist hash of everything above except turn_count
     void init(const Input&);
-    void update1();
-    void update2(const vector<ActionType>&);
-    void update3();
-    void watch();
+    void update1(UndoLog* log = nullptr);
+    // update2 is the unchecked fast path; referee2 validates every action first and
+    // leaves the state untouched when one is illegal
+    void update2(const vector<ActionType>& actions, UndoLog* log = nullptr) { PROFILE_SCOPE(update2); step2<false>(actions.data(), log); }
+    SimStatus referee2(const vector<ActionType>& actions, UndoLog* log = nullptr) { return step2<true>(actions.data(), log); }
+    template<bool REFEREE> SimStatus step2(const ActionType* actions, UndoLog* log);
+    SimStatus check2(const ActionType* actions) const;
+    void update3(UndoLog* log = nullptr);
+    void rollback(UndoLog& log, int mark);
+    void watch(ostream& os = cerr) const;
+    bool has_crane(int i, int j) const { return crane_mask >> (i*n+j) & 1; }
+    bool has_container(int i, int j) const { return container_mask >> (i*n+j) & 1; }
+    int container_at(int i, int j) const { return has_container(i, j) ? container_id[i*n+j] : -1; }
+    int crane_at(int i, int j) const;
+    bool queue_empty(int i) const { return queue_head[i] == n; }
+    int remaining_containers() const;
+    pair<int, int> find_container(int id) const;
+    uint64_t calc_hash() const;
 };
 
+static_assert(is_trivially_copyable_v<Terminal>);
+
 namespace common {
     char act2char(const ActionType);
+    ActionType char2act(const char);
     pair<int, int> act2move(const ActionType);
     int calc_out_i(int id);
-    void print(const vector<vector<ActionType>>&);
+    void print(const vector<vector<ActionType>>&, ostream& os = cout);
+    SimStatus referee(const Input&, const vector<vector<ActionType>>&, Terminal* last = nullptr);
+    constexpr long long INVALID_SCORE = 1LL<<60;
+    long long score(const Input&, const vector<vector<ActionType>>&);
+    long long score(const Terminal& last, long long turns);
 };
 
-void Input::read() {
+void Input::read(istream& is) {
     int n;
-    cin >> n;
+    is >> n;
     a.resize(n, vector<int>(n));
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            cin >> a[i][j];
+            is >> a[i][j];
         }
     }
 }
@@ -116,168 +210,388 @@ void Crane::set_catch_and_release(int _catch_i, int _catch_j, int _release_i, in
     release_j = _release_j;
 }
 
-void common::print(const vector<vector<ActionType>>& actions) {
+void common::print(const vector<vector<ActionType>>& actions, ostream& os) {
     for(int i = 0; i < n; i++) {
         for(const ActionType act: actions[i]) {
             if(act != ActionType::DESTROYED) {
-                cout << common::act2char(act);
+                os << common::act2char(act);
             }
         }
-        cout << endl;
+        os << endl;
     }
 }
 
 void Terminal::init(const Input& in) {
     turn_count = 0;
-    crane_pos.resize(n, vector<shared_ptr<Crane>>(n, nullptr));
-    container_pos.resize(n, vector<shared_ptr<Container>>(n, nullptr));
-    container_queue.resize(n);
-    collected_containers.resize(n);
-    cranes.resize(n);
-    containers.resize(n*n);
+    crane_mask = 0;
+    container_mask = 0;
+    memset(container_id, -1, sizeof(container_id));
     for(int i = 0; i < n; i++) {
-        cranes[i] = make_shared<Crane>(i, 0, i, (i == 0 ? CraneType::LARGE : CraneType::SMALL));
+        Crane& c = cranes[i];
+        c.i = i;
+        c.j = 0;
+        c.crane_type = (i == 0 ? CraneType::LARGE : CraneType::SMALL);
+        c.status = CraneStatus::FREE;
+        c.exist = true;
+        c.container = -1;
+        c.catch_i = c.catch_j = c.release_i = c.release_j = -1;
+        c.prev_container_id = -1;
+        crane_mask |= 1u << (i*n);
     }
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            containers[in.a[i][j]] = make_shared<Container>(i, 0, in.a[i][j], common::calc_out_i(in.a[i][j]));
-            container_queue[i].push(containers[in.a[i][j]]);
+            queue[i][j] = in.a[i][j];
         }
+        queue_head[i] = 0;
     }
+    memset(collected, -1, sizeof(collected));
+    memset(collected_row, -1, sizeof(collected_row));
+    collected_count = 0;
+    memset(out_count, 0, sizeof(out_count));
+    hash = calc_hash();
 }
 
-void Terminal::update1() {
+void Terminal::update1(UndoLog* log) {
+    PROFILE_SCOPE(update1);
+    if(log) log->record_header(*this);
     turn_count++;
     for(int i = 0; i < n; i++) {
-        if(container_queue[i].empty()) {
+        if(queue_empty(i)) {
+            continue;
+        }
+        const int cell = i*n;
+        if(has_container(i, 0)) {
             continue;
         }
-        shared_ptr<Container> c = container_queue[i].front();
-        if( (!container_pos[c->i][c->j]) && 
-            ((!crane_pos[c->i][c->j]) || (!crane_pos[c->i][c->j]->container)) ) {
-            container_pos[c->i][c->j] = move(c);
-            container_queue[i].pop();
-        }   
+        if(has_crane(i, 0) && cranes[crane_at(i, 0)].container != -1) {
+            continue;
+        }
+        if(log) {
+            log->record_cell(*this, cell);
+            log->record_queue_pop(i);
+        }
+        container_mask |= 1u << cell;
+        container_id[cell] = queue[i][queue_head[i]];
+        hash ^= zobrist.cell[cell][container_id[cell]];
+        hash ^= zobrist.queue_head[i][queue_head[i]] ^ zobrist.queue_head[i][queue_head[i]+1];
+        queue_head[i]++;
+    }
+}
+
+// checks run crane by crane and the first failure wins (BatchTerminal::update2_lane uses the
+// same order). containers are tested against the start-of-turn state, which is exact since
+// only the crane standing on a cell can catch or release there.
+SimStatus Terminal::check2(const ActionType* actions) const {
+    int old_cell[n], new_cell[n];
+    bool occupy[n];
+    for(int k = 0; k < n; k++) {
+        const Crane& crane = cranes[k];
+        const ActionType act = actions[k];
+        const bool holding = crane.container != -1;
+        const auto [di, dj] = common::act2move(act);
+        const int ni = crane.i + di;
+        const int nj = crane.j + dj;
+        old_cell[k] = crane.i*n + crane.j;
+        new_cell[k] = ni*n + nj;
+        occupy[k] = crane.exist && act != ActionType::BOMB;
+        SimError err = SimError::ERR_NONE;
+        if(!crane.exist) {
+            if(act != ActionType::DESTROYED) err = SimError::ERR_DESTROYED_CRANE;
+        } else if(act == ActionType::DESTROYED) {
+            err = SimError::ERR_DESTROYED_ACTION;
+        } else if(ni < 0 || nj < 0 || ni >= n || nj >= n) {
+            err = SimError::ERR_OUT_OF_GRID;
+        }
+        for(int m = 0; m < k && err == SimError::ERR_NONE; m++) {
+            if(!occupy[k] || !occupy[m]) continue;
+            if(new_cell[k] == new_cell[m]) err = SimError::ERR_COLLISION;
+            else if(new_cell[k] == old_cell[m] && new_cell[m] == old_cell[k]) err = SimError::ERR_SWAP;
+        }
+        if(err == SimError::ERR_NONE && crane.exist) {
+            const bool moved = di != 0 || dj != 0;
+            const bool on_container = container_mask >> old_cell[k] & 1;
+            if(crane.crane_type == CraneType::SMALL && moved && holding && (container_mask >> new_cell[k] & 1)) err = SimError::ERR_SMALL_OVER_CONTAINER;
+            else if(act == ActionType::CATCH && !on_container) err = SimError::ERR_CATCH_EMPTY;
+            else if(act == ActionType::CATCH && holding) err = SimError::ERR_CATCH_HOLDING;
+            else if(act == ActionType::RELEASE && !holding) err = SimError::ERR_RELEASE_EMPTY;
+            else if(act == ActionType::RELEASE && on_container) err = SimError::ERR_RELEASE_OCCUPIED;
+            else if(act == ActionType::BOMB && holding) err = SimError::ERR_BOMB_HOLDING;
+        }
+        if(err != SimError::ERR_NONE) {
+            return SimStatus{err, turn_count, (int8_t)k};
+        }
     }
+    return SimStatus{SimError::ERR_NONE, turn_count, -1};
 }
 
-void Terminal::update2(const vector<ActionType>& actions) {
-    vector next_crane_pos(n, vector<shared_ptr<Crane>>(n, nullptr));
+template<bool REFEREE>
+SimStatus Terminal::step2(const ActionType* actions, UndoLog* log) {
+    if constexpr (REFEREE) {
+        const SimStatus status = check2(actions);
+        if(!status.ok()) {
+            return status;
+        }
+    }
+    if(log) log->record_header(*this);
+    uint32_t next_crane_mask = 0;
     // move cranes
     for(int i = 0; i < n; i++) {
+        Crane& crane = cranes[i];
         // already disappear
-        if(!cranes[i]->exist) {
-            assert(actions[i] == ActionType::DESTROYED);
+        if(!crane.exist) {
             continue;
         }
+        if(log) log->record_crane(*this, i);
         // L,R,U,D
         auto [di, dj] = common::act2move(actions[i]);
-        const int next_i = cranes[i]->i + di;
-        const int next_j = cranes[i]->j + dj;
-        next_crane_pos[next_i][next_j] = cranes[i];
-        cranes[i]->i = next_i;
-        cranes[i]->j = next_j;
-        if(cranes[i]->container) {
-            cranes[i]->container->i = next_i;
-            cranes[i]->container->j = next_j;
-        }
-        assert(cranes[i] == next_crane_pos[next_i][next_j]);
+        const int next_i = crane.i + di;
+        const int next_j = crane.j + dj;
+        // a bombed crane leaves its cell free for a crane moving in on the same turn
+        if(actions[i] != ActionType::BOMB) {
+            next_crane_mask |= 1u << (next_i*n+next_j);
+        }
+        hash ^= zobrist.crane[i][crane.i*n+crane.j] ^ zobrist.crane[i][next_i*n+next_j];
+        crane.i = next_i;
+        crane.j = next_j;
+        const int cell = next_i*n + next_j;
         // PRE_CATCH -> CATCH
-        if(cranes[i]->status == CraneStatus::PRE_CATCH) {
-            if(cranes[i]->i == cranes[i]->catch_i && cranes[i]->j == cranes[i]->catch_j) {
-                cranes[i]->status = CraneStatus::CATCH_NOW;
+        if(crane.status == CraneStatus::PRE_CATCH) {
+            if(crane.i == crane.catch_i && crane.j == crane.catch_j) {
+                crane.status = CraneStatus::CATCH_NOW;
             }
         }
         // PRE_RELEASE -> RELEASE
-        else if(cranes[i]->status == CraneStatus::PRE_RELEASE) {
-            if(cranes[i]->i == cranes[i]->release_i && cranes[i]->j == cranes[i]->release_j) {
-                cranes[i]->status = CraneStatus::RELEASE_NOW;
+        else if(crane.status == CraneStatus::PRE_RELEASE) {
+            if(crane.i == crane.release_i && crane.j == crane.release_j) {
+                crane.status = CraneStatus::RELEASE_NOW;
             }
         }
         // P, CATCH -> PRE_RELEASE
         if(actions[i] == ActionType::CATCH) {
-            assert(container_pos[cranes[i]->i][cranes[i]->j]);
-            assert(!cranes[i]->container);
-            cranes[i]->container = move(container_pos[cranes[i]->i][cranes[i]->j]);
-            cranes[i]->prev_container_id = cranes[i]->container->id;
-            cranes[i]->status = CraneStatus::PRE_RELEASE;
+            if(log) log->record_cell(*this, cell);
+            crane.container = container_id[cell];
+            hash ^= zobrist.cell[cell][crane.container] ^ zobrist.hold[i][crane.container];
+            container_id[cell] = -1;
+            container_mask &= ~(1u << cell);
+            crane.prev_container_id = crane.container;
+            crane.status = CraneStatus::PRE_RELEASE;
         }
         // Q, RELEASE -> FREE
         if(actions[i] == ActionType::RELEASE) {
-            assert(cranes[i]->container);
-            if(container_pos[cranes[i]->i][cranes[i]->j]) {
-                cerr << cranes[i]->status << endl;
-                cerr << cranes[i]->container->id << ", " << container_pos[cranes[i]->i][cranes[i]->j]->id << endl;
-            }
-            assert(!container_pos[cranes[i]->i][cranes[i]->j]);
-            container_pos[cranes[i]->i][cranes[i]->j] = move(cranes[i]->container);
-            assert(container_pos[cranes[i]->i][cranes[i]->j]->i == cranes[i]->i &&
-                   container_pos[cranes[i]->i][cranes[i]->j]->j == cranes[i]->j );
-            cranes[i]->status = CraneStatus::FREE;
+            if(log) log->record_cell(*this, cell);
+            container_mask |= 1u << cell;
+            container_id[cell] = crane.container;
+            hash ^= zobrist.cell[cell][crane.container] ^ zobrist.hold[i][crane.container];
+            crane.container = -1;
+            crane.status = CraneStatus::FREE;
         }
         // B
         if(actions[i] == ActionType::BOMB) {
-            assert(!cranes[i]->container);
-            cranes[i]->exist = false;
-            next_crane_pos[cranes[i]->i][cranes[i]->j] = nullptr;
+            crane.exist = false;
+            hash ^= zobrist.crane[i][cell];
         }
     }
-    crane_pos = move(next_crane_pos);
+    crane_mask = next_crane_mask;
+    return SimStatus{SimError::ERR_NONE, turn_count, -1};
 }
 
-void Terminal::update3() {
+void Terminal::update3(UndoLog* log) {
+    PROFILE_SCOPE(update3);
+    if(log) log->record_header(*this);
     for(int i = 0; i < n; i++) {
-        if(container_pos[i][n-1]) {
-            collected_containers[i].push_back(container_pos[i][n-1]);
-            container_pos[i][n-1] = nullptr;
+        const int cell = i*n + n-1;
+        if(container_mask >> cell & 1) {
+            if(log) {
+                log->record_cell(*this, cell);
+                log->record_collect(i);
+            }
+            collected[collected_count] = container_id[cell];
+            collected_row[collected_count] = i;
+            collected_count++;
+            hash ^= zobrist.cell[cell][container_id[cell]];
+            hash ^= zobrist.out_count[i][out_count[i]] ^ zobrist.out_count[i][out_count[i]+1];
+            out_count[i]++;
+            container_id[cell] = -1;
+            container_mask &= ~(1u << cell);
+        }
+    }
+}
+
+void Terminal::rollback(UndoLog& log, int mark) {
+    // undo in reverse order, so the oldest header of the range is restored last
+    while(log.mark() > mark) {
+        const UndoEntry& e = log.entries.back();
+        if(e.type == UndoType::UNDO_HEADER) {
+            turn_count = e.turn_count;
+            crane_mask = e.crane_mask;
+            container_mask = e.container_mask;
+            hash = e.hash;
+        } else if(e.type == UndoType::UNDO_CRANE) {
+            cranes[e.idx] = e.crane;
+        } else if(e.type == UndoType::UNDO_CELL) {
+            container_id[e.idx] = e.cell_id;
+        } else if(e.type == UndoType::UNDO_QUEUE_POP) {
+            queue_head[e.idx]--;
+        } else if(e.type == UndoType::UNDO_COLLECT) {
+            collected_count--;
+            out_count[collected_row[collected_count]]--;
+            collected[collected_count] = -1;
+            collected_row[collected_count] = -1;
+        }
+        log.entries.pop_back();
+    }
+}
+
+void UndoLog::record_header(const Terminal& term) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_HEADER;
+    e.turn_count = term.turn_count;
+    e.crane_mask = term.crane_mask;
+    e.container_mask = term.container_mask;
+    e.hash = term.hash;
+    entries.push_back(e);
+}
+
+void UndoLog::record_crane(const Terminal& term, int k) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_CRANE;
+    e.idx = k;
+    e.crane = term.cranes[k];
+    entries.push_back(e);
+}
+
+void UndoLog::record_cell(const Terminal& term, int cell) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_CELL;
+    e.idx = cell;
+    e.cell_id = term.container_id[cell];
+    entries.push_back(e);
+}
+
+void UndoLog::record_queue_pop(int i) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_QUEUE_POP;
+    e.idx = i;
+    entries.push_back(e);
+}
+
+void UndoLog::record_collect(int i) {
+    UndoEntry e;
+    e.type = UndoType::UNDO_COLLECT;
+    e.idx = i;
+    entries.push_back(e);
+}
+
+int Terminal::crane_at(int i, int j) const {
+    if(!has_crane(i, j)) {
+        return -1;
+    }
+    for(int k = 0; k < n; k++) {
+        if(cranes[k].exist && cranes[k].i == i && cranes[k].j == j) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+int Terminal::remaining_containers() const {
+    return n*n - collected_count;
+}
+
+pair<int, int> Terminal::find_container(int id) const {
+    for(uint32_t mask = container_mask; mask; mask &= mask - 1) {
+        const int cell = countr_zero(mask);
+        if(container_id[cell] == id) {
+            return make_pair(cell / n, cell % n);
+        }
+    }
+    for(int k = 0; k < n; k++) {
+        if(cranes[k].exist && cranes[k].container == id) {
+            return make_pair((int)cranes[k].i, (int)cranes[k].j);
         }
     }
+    return make_pair(-1, -1);
 }
 
-void Terminal::watch() {
+// full rescan; update1/update2/update3 keep hash up to date incrementally
+uint64_t Terminal::calc_hash() const {
+    uint64_t res = 0;
+    for(int k = 0; k < n; k++) {
+        const Crane& c = cranes[k];
+        if(!c.exist) {
+            continue;
+        }
+        res ^= zobrist.crane[k][c.i*n+c.j];
+        if(c.container != -1) {
+            res ^= zobrist.hold[k][c.container];
+        }
+    }
+    for(uint32_t mask = container_mask; mask; mask &= mask - 1) {
+        const int cell = countr_zero(mask);
+        res ^= zobrist.cell[cell][container_id[cell]];
+    }
+    for(int i = 0; i < n; i++) {
+        res ^= zobrist.queue_head[i][queue_head[i]];
+        res ^= zobrist.out_count[i][out_count[i]];
+    }
+    return res;
+}
+
+void Terminal::watch(ostream& os) const {
     // watch status for debugging
 
     // collected containers
-    cerr << "collected: " << collected_containers.size() << endl;
+    os << "collected: " << n*n - remaining_containers() << endl;
     for(int i = 0; i < n; i++) {
-        cerr << " " << i << ": ";
-        for(auto c: collected_containers[i]) cerr << c->id << ", ";
-        cerr << endl;
+        os << " " << i << ": ";
+        for(int k = 0; k < collected_count; k++) if(collected_row[k] == i) os << (int)collected[k] << ", ";
+        os << endl;
     }
-    cerr << endl;
+    os << endl;
 
     // queueing containers
-    // TODO
+    os << "queue: " << endl;
+    for(int i = 0; i < n; i++) {
+        os << " " << i << ": ";
+        for(int k = queue_head[i]; k < n; k++) os << (int)queue[i][k] << ", ";
+        os << endl;
+    }
+    os << endl;
 
     // container map
-    cerr << "conatiner map: " << endl;
+    os << "conatiner map: " << endl;
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            if(container_pos[i][j]) {
-                cerr << setw(2) << container_pos[i][j]->id;
+            if(has_container(i, j)) {
+                os << setw(2) << container_at(i, j);
             } else {
-                cerr << "  ";
+                os << "  ";
             }
-            cerr << "|"; 
+            os << "|"; 
         }
-        cerr << endl;
+        os << endl;
     }
-    cerr << endl;
+    os << endl;
 
     // crane map
-    cerr << "crane map: " << endl;
+    os << "crane map: " << endl;
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            if(crane_pos[i][j]) {
-                cerr << setw(2) << crane_pos[i][j]->id;
+            if(has_crane(i, j)) {
+                os << setw(2) << crane_at(i, j);
             } else {
-                cerr << "  ";
+                os << "  ";
             }
-            cerr << "|"; 
+            os << "|"; 
         }
-        cerr << endl;
+        os << endl;
     }
-    cerr << endl;
+    os << endl;
+}
+
+ostream& operator<<(ostream& os, const Terminal& term) {
+    term.watch(os);
+    return os;
 }
 
 char common::act2char(const ActionType act) {
@@ -292,6 +606,18 @@ char common::act2char(const ActionType act) {
     return '?';
 }
 
+ActionType common::char2act(const char c) {
+    if(c == 'P') return ActionType::CATCH;
+    if(c == 'Q') return ActionType::RELEASE;
+    if(c == 'U') return ActionType::UP;
+    if(c == 'D') return ActionType::DOWN;
+    if(c == 'L') return ActionType::LEFT;
+    if(c == 'R') return ActionType::RIGHT;
+    if(c == '.') return ActionType::WAIT;
+    if(c == 'B') return ActionType::BOMB;
+    return ActionType::DESTROYED;
+}
+
 pair<int,int> common::act2move(const ActionType act) {
     int i = 0;
     int j = 0;
@@ -306,4 +632,76 @@ int common::calc_out_i(int id) {
     return id / n;
 }
 
+// replays a whole solution through the referee; last receives the final (or last legal) state
+SimStatus common::referee(const Input& in, const vector<vector<ActionType>>& actions, Terminal* last) {
+    Terminal term;
+    term.init(in);
+    SimStatus status{SimError::ERR_NONE, 0, -1};
+    // rows may differ in length (a bombed crane's line ends early): replay the longest one
+    // and let a crane past the end of its row wait, or stay destroyed
+    int turns = 0;
+    for(const auto& row : actions) {
+        turns = max(turns, (int)row.size());
+    }
+    vector<ActionType> acts(n);
+    for(int t = 0; t < turns && status.ok(); t++) {
+        for(int k = 0; k < n; k++) {
+            if(k < (int)actions.size() && t < (int)actions[k].size()) {
+                acts[k] = actions[k][t];
+            } else {
+                acts[k] = term.cranes[k].exist ? ActionType::WAIT : ActionType::DESTROYED;
+            }
+        }
+        term.update1();
+        status = term.referee2(acts);
+        if(status.ok()) {
+            term.update3();
+        }
+    }
+    if(last) {
+        *last = term;
+    }
+    return status;
+}
+
+// official AHC033 score (lower is better):
+// turns + 100*inversions + 10^4*wrong outlet + 10^6*undelivered, INVALID_SCORE if illegal
+long long common::score(const Input& in, const vector<vector<ActionType>>& actions) {
+    Terminal term;
+    if(!common::referee(in, actions, &term).ok()) {
+        return INVALID_SCORE;
+    }
+    // a bombed crane prints no DESTROYED actions, so the longest output line is the turn count
+    long long turns = 0;
+    for(const auto& row : actions) {
+        long long len = 0;
+        for(const ActionType act : row) {
+            if(act != ActionType::DESTROYED) len++;
+        }
+        turns = max(turns, len);
+    }
+    return common::score(term, turns);
+}
+
+// score of a legal run that ended in state last after turns turns
+long long common::score(const Terminal& term, long long turns) {
+    if(turns > MAX_TURN) {
+        return INVALID_SCORE;
+    }
+    long long inversions = 0;
+    long long wrong = 0;
+    for(int a = 0; a < term.collected_count; a++) {
+        if(common::calc_out_i(term.collected[a]) != term.collected_row[a]) {
+            wrong++;
+        }
+        for(int b = a+1; b < term.collected_count; b++) {
+            if(term.collected_row[a] == term.collected_row[b] && term.collected[a] > term.collected[b]) {
+                inversions++;
+            }
+        }
+    }
+    const long long undelivered = term.remaining_containers();
+    return turns + 100*inversions + 10000*wrong + 1000000*undelivered;
+}
+
 #endif
\ No newline at end of file
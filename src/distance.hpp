@@ -0,0 +1,70 @@
+#ifndef __DISTANCE_HPP__
+#define __DISTANCE_HPP__
+
+#include "common.hpp"
+
+// shifts on 25-bit cell masks (bit i*n+j is cell (i, j))
+namespace bitboard {
+    constexpr uint32_t full = (1u << (n*n)) - 1;
+    constexpr uint32_t first_col = 0x108421;
+    constexpr uint32_t last_col = first_col << (n-1);
+    // cells one step away from any cell of mask
+    constexpr uint32_t neighbors(uint32_t mask) {
+        return ((mask << n) | (mask >> n) | ((mask & ~last_col) << 1) | ((mask & ~first_col) >> 1)) & full;
+    }
+};
+
+// exact grid distances from one source cell, -1 where unreachable.
+// obstacle cells are never entered; the source itself is always passable.
+struct DistanceField {
+    int8_t d[n*n];
+    void build(int src, uint32_t obstacle);
+};
+
+void DistanceField::build(int src, uint32_t obstacle) {
+    memset(d, -1, sizeof(d));
+    const uint32_t free = ~obstacle & bitboard::full;
+    uint32_t visited = 1u << src;
+    uint32_t frontier = visited;
+    for(int dist = 0; frontier; dist++) {
+        for(uint32_t mask = frontier; mask; mask &= mask - 1) {
+            d[countr_zero(mask)] = dist;
+        }
+        frontier = bitboard::neighbors(frontier) & free & ~visited;
+        visited |= frontier;
+    }
+}
+
+// direct-mapped cache of fields keyed by (source, obstacle mask); a miss just rebuilds the slot
+struct DistanceCache {
+    static constexpr int bucket_bits = 14;
+    struct Slot {
+        uint64_t key;
+        DistanceField field;
+    };
+    vector<Slot> slots;
+    long long hit_counter, miss_counter;
+    DistanceCache() : slots(1 << bucket_bits, Slot{~0ull, {}}), hit_counter(0), miss_counter(0) {}
+    const DistanceField& get(int src, uint32_t obstacle);
+    int dist(int src, int dst, uint32_t obstacle) { return get(src, obstacle).d[dst]; }
+    int dist(int si, int sj, int ti, int tj, uint32_t obstacle) { return dist(si*n+sj, ti*n+tj, obstacle); }
+};
+
+// one cache per thread, so solvers can run concurrently
+thread_local DistanceCache dist_cache;
+
+const DistanceField& DistanceCache::get(int src, uint32_t obstacle) {
+    const uint64_t key = (uint64_t)obstacle << 5 | src;
+    const int bucket = (key * 0x9e3779b97f4a7c15ull) >> (64 - bucket_bits);
+    Slot& slot = slots[bucket];
+    if(slot.key == key) {
+        hit_counter++;
+    } else {
+        miss_counter++;
+        slot.key = key;
+        slot.field.build(src, obstacle);
+    }
+    return slot.field;
+}
+
+#endif
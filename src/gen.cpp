@@ -0,0 +1,41 @@
+// writes instances made by generator::generate.
+//   g++ -std=c++20 -O2 gen.cpp -o gen
+//   ./gen <seed>                      one instance to stdout
+//   ./gen <first> <count> <dir>       dir/<seed>.txt for count seeds, as tools/in/0000.txt
+#include "common.hpp"
+#include "generator.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+using namespace std;
+
+int main(int argc, char** argv) {
+
+    if(argc != 2 && argc != 4) {
+        cerr << "usage: " << argv[0] << " <seed> | <first> <count> <dir>" << endl;
+        return 1;
+    }
+    const uint64_t first = strtoull(argv[1], nullptr, 10);
+    if(argc == 2) {
+        generator::write(cout, generator::generate(first));
+        return 0;
+    }
+    const long long count = atoll(argv[2]);
+    const string dir = argv[3];
+    Input in;
+    for(long long k = 0; k < count; k++) {
+        const uint64_t seed = first + k;
+        char name[32];
+        snprintf(name, sizeof(name), "/%04llu.txt", (unsigned long long)seed);
+        ofstream ofs(dir + name);
+        if(!ofs) {
+            cerr << "cannot write " << dir + name << endl;
+            return 1;
+        }
+        generator::generate(seed, in);
+        generator::write(ofs, in);
+    }
+
+}
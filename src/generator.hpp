@@ -0,0 +1,56 @@
+#ifndef __GENERATOR_HPP__
+#define __GENERATOR_HPP__
+
+#include "common.hpp"
+#include <ostream>
+
+// instances from the official distribution: a uniformly random permutation of the
+// n*n containers laid out row by row as the arrival grid. the same seed always gives
+// the same instance, but not the same one as the official tools for that seed.
+namespace generator {
+
+// splitmix64: cheap to seed, so one instance costs a few dozen ns
+inline uint64_t next(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// fills res, reusing its storage
+void generate(uint64_t seed, Input& res) {
+    uint64_t state = seed;
+    int ids[n*n];
+    for(int k = 0; k < n*n; k++) {
+        ids[k] = k;
+    }
+    // fisher-yates; the multiply-shift maps 64 random bits to [0, k] with negligible bias
+    for(int k = n*n - 1; k > 0; k--) {
+        const int j = (unsigned __int128)next(state) * (k + 1) >> 64;
+        swap(ids[k], ids[j]);
+    }
+    res.a.resize(n);
+    for(int i = 0; i < n; i++) {
+        res.a[i].assign(ids + i*n, ids + (i+1)*n);
+    }
+}
+
+Input generate(uint64_t seed) {
+    Input res;
+    generate(seed, res);
+    return res;
+}
+
+// same text format as the official input files
+void write(ostream& os, const Input& in) {
+    os << n << "\n";
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n; j++) {
+            os << in.a[i][j] << (j+1 < n ? " " : "\n");
+        }
+    }
+}
+
+} // namespace generator
+
+#endif
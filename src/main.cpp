@@ -1,24 +1,87 @@
 #include "common.hpp"
 #include "solver_000.hpp"
 #include "solver_001.hpp"
+#include "solver_002.hpp"
+#include "solver_003.hpp"
 #include "toki.hpp"
+#include "trace.hpp"
+#include "portfolio.hpp"
+#include "runner.hpp"
 #include <iostream>
+#include <cstdlib>
 using namespace std;
 
-Input in;
+thread_local Input in;
 extern Timer toki;
 
-int main() {
+// default deadline: the portfolio answers once toki.elapsed() reaches it
+constexpr double time_limit = 2.5;
+
+// every solver runs on its own thread and publishes to a shared incumbent;
+// whatever it holds at the deadline is the answer
+void add_solvers(Portfolio& portfolio) {
+    portfolio.add("solver_000", [](const Context& ctx, double deadline, Incumbent& incumbent) { solver_000::solve(ctx, deadline, incumbent); });
+    portfolio.add("solver_001", [](const Context& ctx, double deadline, Incumbent& incumbent) { sovler_001::solve(ctx, deadline, incumbent); }, true);
+    portfolio.add("solver_002", [](const Context& ctx, double deadline, Incumbent& incumbent) { solver_002::solve(ctx, deadline, incumbent); });
+    portfolio.add("solver_003", [](const Context& ctx, double deadline, Incumbent& incumbent) { solver_003::solve(ctx, deadline, incumbent); }, true);
+}
+
+// threads is the budget of the whole portfolio, solver_001's restarts and solver_003's
+// replicas included
+vector<vector<ActionType>> solve(double deadline, int threads) {
+    Portfolio portfolio;
+    add_solvers(portfolio);
+    return portfolio.run(in, ryuka.seed, deadline, threads);
+}
+
+int main(int argc, char** argv) {
 
     toki.init();
-    in.read();
+    // a failed assert prints the last debug lines of every thread
+    logger::install_crash_handler();
+    // AHC_SEED=<u64> reproduces a run whose seed was recorded in a trace
+    if(const char* seed = getenv("AHC_SEED")) {
+        ryuka.init(strtoull(seed, nullptr, 10));
+    }
 
-    vector<vector<ActionType>> ans = solver_000::solve();
-    vector<vector<ActionType>> ans_001 = sovler_001::solve();
-    if(ans_001.front().size() < ans.front().size()) {
-        ans = ans_001;
+    // --batch <dir or glob> [--out dir] [--csv path] [--threads k] [--instance-threads k] [--time sec]
+    if(argc > 1) {
+        runner::Options opt;
+        opt.time_limit = time_limit;
+        // one thread per solver of the portfolio
+        opt.instance_threads = 4;
+        if(!runner::parse(argc, argv, opt)) {
+            cerr << "usage: " << argv[0] << " [--batch <dir or glob> [--out dir] [--csv path] [--threads k] [--instance-threads k] [--time sec]]" << endl;
+            return 1;
+        }
+        // per-instance logs would interleave across threads
+        cerr.setstate(ios::badbit);
+        runner::run(opt, ryuka.seed, solve);
+        // totals over the whole batch, next to its summary
+        profile::report(cout);
+        return 0;
     }
-    
+
+    in.read();
+    // the answer is printed (and flushed) before the solver threads are joined: one still
+    // finishing its current step must not delay the output
+    Portfolio portfolio;
+    add_solvers(portfolio);
+    vector<vector<ActionType>> ans = portfolio.run(in, ryuka.seed, time_limit, max(1, (int)thread::hardware_concurrency()));
     common::print(ans);
+    portfolio.join();
+
+    // AHC_TRACE=<path> writes a binary trace of the chosen answer for offline replay
+    if(const char* path = getenv("AHC_TRACE")) {
+        Trace::build(in, ryuka.seed, ans, 100).save(path);
+    }
+
+    // -DAHC_PROFILE: per-phase times and counters, in the log next to the solvers' lines
+    profile::report(cerr);
+
+    // AHC_LOG_DUMP=1 prints the debug ring buffers even when nothing failed
+    if(getenv("AHC_LOG_DUMP")) {
+        logger::dump();
+    }
 
 }
@@ -0,0 +1,132 @@
+#ifndef __PACKED_HPP__
+#define __PACKED_HPP__
+
+#include "common.hpp"
+#include <array>
+#include <memory>
+#include <string>
+
+// solution packed as 4 bits per crane-action with the n cranes of a turn side by side
+// (20 bits per turn, 3 turns per word). words live in fixed-size chunks shared between
+// copies; only the tail chunk is cloned when a shared copy appends, so copying a
+// candidate costs one pointer per chunk.
+struct PackedActions {
+    static constexpr int bits = 4;
+    static constexpr int turn_bits = bits * n;
+    static constexpr int turns_per_word = 64 / turn_bits;
+    static constexpr int chunk_words = 64;
+    static constexpr int chunk_turns = chunk_words * turns_per_word;
+    using Chunk = array<uint64_t, chunk_words>;
+
+    vector<shared_ptr<Chunk>> chunks;
+    int turns = 0;
+
+    int size() const { return turns; }
+    ActionType get(int t, int k) const;
+    vector<ActionType> turn(int t) const;
+    void push_back(const vector<ActionType>& actions);
+    void truncate(int t);
+
+    static PackedActions pack(const vector<vector<ActionType>>& actions);
+    vector<vector<ActionType>> unpack() const;
+    void print() const;
+    static PackedActions read(istream& is);
+};
+
+ActionType PackedActions::get(int t, int k) const {
+    const uint64_t word = (*chunks[t / chunk_turns])[t % chunk_turns / turns_per_word];
+    const int shift = t % turns_per_word * turn_bits + k * bits;
+    return (ActionType)(word >> shift & ((1u << bits) - 1));
+}
+
+vector<ActionType> PackedActions::turn(int t) const {
+    vector<ActionType> res(n);
+    for(int k = 0; k < n; k++) {
+        res[k] = get(t, k);
+    }
+    return res;
+}
+
+void PackedActions::push_back(const vector<ActionType>& actions) {
+    const int c = turns / chunk_turns;
+    if(c == (int)chunks.size()) {
+        chunks.push_back(make_shared<Chunk>());
+    } else if(chunks[c].use_count() > 1) {
+        chunks[c] = make_shared<Chunk>(*chunks[c]);
+    }
+    uint64_t packed = 0;
+    for(int k = 0; k < n; k++) {
+        packed |= (uint64_t)actions[k] << (k * bits);
+    }
+    uint64_t& word = (*chunks[c])[turns % chunk_turns / turns_per_word];
+    const int shift = turns % turns_per_word * turn_bits;
+    // stale bits may remain past a truncate, so overwrite instead of or-ing
+    word = (word & ~(((1ull << turn_bits) - 1) << shift)) | packed << shift;
+    turns++;
+}
+
+void PackedActions::truncate(int t) {
+    assert(0 <= t && t <= turns);
+    turns = t;
+    chunks.resize((t + chunk_turns - 1) / chunk_turns);
+}
+
+PackedActions PackedActions::pack(const vector<vector<ActionType>>& actions) {
+    PackedActions res;
+    const int len = actions.front().size();
+    vector<ActionType> acts(n);
+    for(int t = 0; t < len; t++) {
+        for(int k = 0; k < n; k++) {
+            acts[k] = actions[k][t];
+        }
+        res.push_back(acts);
+    }
+    return res;
+}
+
+vector<vector<ActionType>> PackedActions::unpack() const {
+    vector<vector<ActionType>> res(n, vector<ActionType>(turns));
+    for(int t = 0; t < turns; t++) {
+        for(int k = 0; k < n; k++) {
+            res[k][t] = get(t, k);
+        }
+    }
+    return res;
+}
+
+// same text as common::print
+void PackedActions::print() const {
+    for(int k = 0; k < n; k++) {
+        string line;
+        line.reserve(turns);
+        for(int t = 0; t < turns; t++) {
+            const ActionType act = get(t, k);
+            if(act != ActionType::DESTROYED) {
+                line += common::act2char(act);
+            }
+        }
+        cout << line << endl;
+    }
+}
+
+// parses the output format; a line shorter than the longest one belongs to a bombed
+// crane and is padded with DESTROYED
+PackedActions PackedActions::read(istream& is) {
+    vector<string> lines(n);
+    size_t len = 0;
+    for(int k = 0; k < n; k++) {
+        getline(is, lines[k]);
+        len = max(len, lines[k].size());
+    }
+    PackedActions res;
+    vector<ActionType> acts(n);
+    for(size_t t = 0; t < len; t++) {
+        for(int k = 0; k < n; k++) {
+            acts[k] = t < lines[k].size() ? common::char2act(lines[k][t]) : ActionType::DESTROYED;
+        }
+        res.push_back(acts);
+    }
+    return res;
+}
+
+#endif
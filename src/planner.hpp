@@ -0,0 +1,212 @@
+#ifndef __PLANNER_HPP__
+#define __PLANNER_HPP__
+
+#include "common.hpp"
+#include "distance.hpp"
+#include <numeric>
+#include <algorithm>
+#include <random>
+
+// prioritized cooperative planner on the space-time grid.
+// cranes are planned one at a time against a reservation table filled by the cranes
+// planned before them (stationary cranes first, then the large crane, then small cranes
+// holding a container, then the rest). a path ends on a cell its crane can hold until
+// the horizon, and the crane is assumed to stay there afterwards.
+// paths are kept between turns and replanned only when they stop being valid.
+struct Planner {
+    static constexpr int horizon = 16;
+    vector<int> path[n];            // path[k][t]: cell of crane k t turns from now, empty if not planned
+    int goal[n];
+    uint32_t occupied[horizon+1];   // reserved cells at each time step
+    uint32_t busy_after[horizon+1]; // cells reserved at some time step >= t
+    int order[n];
+    int planned_count;
+    uint32_t yield_mask;            // goals of the cranes with one; a crane without a goal keeps off them
+    long long replan_counter;
+    Planner() : planned_count(0), yield_mask(0), replan_counter(0) { fill(goal, goal+n, -1); }
+    // goals[k]: cell crane k heads for (-1: anywhere it can stay); pinned[k]: crane k must stay this turn (catch / release)
+    // shuffle: plan the moving cranes in random order instead of by rank, to break a deadlock
+    void plan(const Terminal&, const int* goals, const bool* pinned, mt19937& engine, bool shuffle = false);
+    int next_cell(int k) const { return path[k].empty() ? -1 : path[k][min(1, (int)path[k].size()-1)]; }
+    int cell_at(int k, int t) const { return path[k][min(t, (int)path[k].size()-1)]; }
+    bool swaps(int from, int to, int t) const;
+    bool valid(int k, uint32_t obstacle) const;
+    bool search(int k, int start, uint32_t obstacle, mt19937& engine);
+    void reserve(int k);
+};
+
+// true if a planned crane moves to -> from while another one moves from -> to at time t
+bool Planner::swaps(int from, int to, int t) const {
+    for(int p = 0; p < planned_count; p++) {
+        const int m = order[p];
+        if(cell_at(m, t) == to && cell_at(m, t+1) == from) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Planner::valid(int k, uint32_t obstacle) const {
+    const vector<int>& cells = path[k];
+    if(cells.empty() || (int)cells.size() > horizon+1) {
+        return false;
+    }
+    for(int t = 0; t+1 < (int)cells.size(); t++) {
+        const int to = cells[t+1];
+        if(occupied[t+1] >> to & 1) return false;
+        if(to != cells[t] && ((obstacle >> to & 1) || swaps(cells[t], to, t))) return false;
+    }
+    return !(busy_after[cells.size()-1] >> cells.back() & 1);
+}
+
+// time-expanded BFS; picks the holdable state closest to the goal, then the earliest one
+bool Planner::search(int k, int start, uint32_t obstacle, mt19937& engine) {
+    replan_counter++;
+    constexpr int di[5] = {0, 1, -1, 0, 0};
+    constexpr int dj[5] = {0, 0, 0, 1, -1};
+    int8_t parent[horizon+1][n*n];
+    const DistanceField* field = goal[k] == -1 ? nullptr : &dist_cache.get(goal[k], obstacle);
+    auto goal_dist = [&](int cell) -> int {
+        if(field == nullptr) return yield_mask >> cell & 1;
+        if(field->d[cell] != -1) return field->d[cell];
+        return 100 + abs(cell / n - goal[k] / n) + abs(cell % n - goal[k] % n);
+    };
+    int dir[5] = {0, 1, 2, 3, 4};
+    shuffle(dir, dir+5, engine);
+    int best_cell = -1, best_t = -1, best_dist = 1 << 30;
+    uint32_t layer = 1u << start;
+    for(int t = 0; layer; t++) {
+        for(uint32_t mask = layer & ~busy_after[t]; mask; mask &= mask - 1) {
+            const int cell = countr_zero(mask);
+            const int d = goal_dist(cell);
+            if(d < best_dist) {
+                best_dist = d;
+                best_cell = cell;
+                best_t = t;
+            }
+        }
+        if(t == horizon || best_dist == 0) {
+            break;
+        }
+        uint32_t next_layer = 0;
+        for(uint32_t mask = layer; mask; mask &= mask - 1) {
+            const int cell = countr_zero(mask);
+            const int i = cell / n;
+            const int j = cell % n;
+            for(int d : dir) {
+                const int ni = i + di[d];
+                const int nj = j + dj[d];
+                if(ni < 0 || nj < 0 || ni >= n || nj >= n) continue;
+                const int to = ni*n + nj;
+                if((next_layer | occupied[t+1]) >> to & 1) continue;
+                if(to != cell && ((obstacle >> to & 1) || swaps(cell, to, t))) continue;
+                next_layer |= 1u << to;
+                parent[t+1][to] = cell;
+            }
+        }
+        layer = next_layer;
+    }
+    if(best_cell == -1) {
+        return false;
+    }
+    path[k].assign(best_t+1, -1);
+    for(int t = best_t, cell = best_cell; t >= 0; t--) {
+        path[k][t] = cell;
+        if(t > 0) cell = parent[t][cell];
+    }
+    return true;
+}
+
+void Planner::reserve(int k) {
+    for(int t = 0; t <= horizon; t++) {
+        occupied[t] |= 1u << cell_at(k, t);
+    }
+    busy_after[horizon] = occupied[horizon];
+    for(int t = horizon-1; t >= 0; t--) {
+        busy_after[t] = occupied[t] | busy_after[t+1];
+    }
+    order[planned_count++] = k;
+}
+
+void Planner::plan(const Terminal& term, const int* goals, const bool* pinned, mt19937& engine, bool shuffle) {
+    bool stationary[n];
+    uint32_t obstacle[n];
+    for(int k = 0; k < n; k++) {
+        const Crane& c = term.cranes[k];
+        const int cur = c.i*n + c.j;
+        stationary[k] = pinned[k];
+        obstacle[k] = 0;
+        if(!c.exist) {
+            path[k].clear();
+            continue;
+        }
+        if(c.crane_type == CraneType::SMALL && c.container != -1) {
+            obstacle[k] = term.container_mask & ~(1u << cur);
+        }
+        // drop the step taken last turn; a crane that went off its path is replanned
+        if(path[k].size() > 1 && path[k][1] == cur) {
+            path[k].erase(path[k].begin());
+        }
+        // a path that stopped short of its goal is retried every turn
+        if(path[k].empty() || path[k][0] != cur || goal[k] != goals[k] || (goals[k] != -1 && path[k].back() != goals[k])) {
+            path[k].clear();
+        }
+        goal[k] = goals[k];
+    }
+    yield_mask = 0;
+    for(int k = 0; k < n; k++) {
+        if(term.cranes[k].exist && goals[k] != -1) {
+            yield_mask |= 1u << goals[k];
+        }
+    }
+    // a crane without a goal that would end up on someone's goal moves aside; when shuffling
+    // every path is searched again
+    for(int k = 0; k < n; k++) {
+        if(shuffle || (goals[k] == -1 && !path[k].empty() && (yield_mask >> path[k].back() & 1))) {
+            path[k].clear();
+        }
+    }
+    int noise[n] = {};
+    if(shuffle) {
+        for(int k = 0; k < n; k++) {
+            noise[k] = engine() % n;
+        }
+    }
+    auto rank = [&](int k) -> int {
+        const Crane& c = term.cranes[k];
+        if(stationary[k]) return 0;
+        if(shuffle) return 1 + noise[k];
+        if(c.crane_type == CraneType::LARGE) return 1;
+        if(c.container != -1) return 2;
+        return 3;
+    };
+    // a crane left without any safe move is made stationary and everyone is replanned;
+    // cranes that all stay put never collide, so this terminates
+    while(true) {
+        int ids[n];
+        iota(ids, ids+n, 0);
+        stable_sort(ids, ids+n, [&](int a, int b) { return rank(a) < rank(b); });
+        fill(occupied, occupied+horizon+1, 0);
+        fill(busy_after, busy_after+horizon+1, 0);
+        planned_count = 0;
+        int failed = -1;
+        for(int k : ids) {
+            const Crane& c = term.cranes[k];
+            if(!c.exist) continue;
+            const int cur = c.i*n + c.j;
+            if(stationary[k]) {
+                path[k].assign(1, cur);
+            } else if(!valid(k, obstacle[k]) && !search(k, cur, obstacle[k], engine)) {
+                failed = k;
+                break;
+            }
+            reserve(k);
+        }
+        if(failed == -1) {
+            return;
+        }
+        stationary[failed] = true;
+    }
+}
+
+#endif
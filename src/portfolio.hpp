@@ -0,0 +1,91 @@
+#ifndef __PORTFOLIO_HPP__
+#define __PORTFOLIO_HPP__
+
+#include "common.hpp"
+#include "ryuka.hpp"
+#include "toki.hpp"
+#include "anytime.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <thread>
+
+extern thread_local RandGenerator ryuka;
+extern thread_local Input in;
+extern Timer toki;
+
+// runs every registered solver on its own thread against one shared Incumbent.
+// each thread reseeds its own ryuka from the master seed and the solver's index and
+// copies the input into its own in.
+// run returns the incumbent as soon as all solvers are done, or grace seconds past
+// the deadline otherwise, and cancels whatever is still running without waiting for it;
+// join (or the destructor) waits. the threads own copies of everything run was given,
+// and solvers must only read shared globals.
+// the thread budget given to run is split here and nowhere else: a serial solver counts
+// as one thread, and the parallel ones share what is left (at least one each) through
+// Context::threads.
+struct Portfolio {
+    using Solver = function<void(const Context&, double deadline, Incumbent&)>;
+    struct Entry {
+        string name;
+        Solver solve;
+        bool parallel;          // uses Context::threads threads instead of just its own
+    };
+    vector<Entry> entries;
+    Incumbent incumbent;
+    vector<thread> threads;
+    mutex mtx;
+    condition_variable done_cv;
+    int done_count = 0;
+    ~Portfolio() { join(); }
+    void add(const string& name, Solver solve, bool parallel = false);
+    vector<vector<ActionType>> run(const Input& in, uint64_t seed, double deadline, int budget, double grace = 0.1);
+    void join();
+};
+
+void Portfolio::add(const string& name, Solver solve, bool parallel) {
+    entries.push_back(Entry{name, solve, parallel});
+}
+
+vector<vector<ActionType>> Portfolio::run(const Input& in, uint64_t seed, double deadline, int budget, double grace) {
+    const int parallel_count = count_if(entries.begin(), entries.end(), [](const Entry& e) { return e.parallel; });
+    const int spare = max(0, budget - ((int)entries.size() - parallel_count));
+    for(int k = 0, p = 0; k < (int)entries.size(); k++) {
+        int share = 1;
+        if(entries[k].parallel) {
+            // the first spare % parallel_count parallel solvers get one more
+            share = max(1, spare / parallel_count + (p < spare % parallel_count));
+            p++;
+        }
+        LOG_DEBUG(entries[k].name << " threads = " << share);
+        threads.emplace_back([this, k, share, in, seed, deadline]() {
+            const Context ctx{in, RandGenerator::derive(seed, k), entries[k].name, share};
+            ryuka.init(ctx.seed);
+            ::in = ctx.in;
+            entries[k].solve(ctx, deadline, incumbent);
+            lock_guard<mutex> lock(mtx);
+            done_count++;
+            done_cv.notify_all();
+        });
+    }
+    {
+        unique_lock<mutex> lock(mtx);
+        const chrono::duration<double> wait(max(0.0, deadline + grace - toki.elapsed()));
+        done_cv.wait_for(lock, wait, [&]() { return done_count == (int)entries.size(); });
+    }
+    incumbent.cancel();
+    LOG_INFO("best = " << incumbent.bound());
+    return incumbent.get();
+}
+
+// solvers poll the incumbent, so this returns shortly after run
+void Portfolio::join() {
+    incumbent.cancel();
+    for(thread& th : threads) {
+        th.join();
+    }
+    threads.clear();
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef __PROFILE_HPP__
+#define __PROFILE_HPP__
+
+#include "toki.hpp"
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// scoped phase timers and event counters. compiled in with -DAHC_PROFILE; otherwise the
+// macros expand to nothing and report() prints nothing. every thread accumulates into its
+// own thread_local table, which is folded into the process totals when the thread exits.
+//   PROFILE_SCOPE(update1);             // time of the enclosing block, one call
+//   PROFILE_COUNT(anneal_iterations);   // +1 on a counter
+// report() writes "profile_<name>_calls / _time / _count = value" lines, which is the
+// key = value format run.py and analyze.py read from the log.
+namespace profile {
+
+enum Phase {
+    update1,
+    update2,
+    update3,
+    update_cr_tasks,
+    assign_tasks,
+    lookahead,
+    plan_paths,
+    get_next_action,
+    neighbour,
+    solver_000,
+    solver_001,
+    solver_002,
+    solver_003,
+    phase_count,
+};
+
+constexpr const char* phase_names[phase_count] = {
+    "update1",
+    "update2",
+    "update3",
+    "update_cr_tasks",
+    "assign_tasks",
+    "lookahead",
+    "plan_paths",
+    "get_next_action",
+    "neighbour",
+    "solver_000",
+    "solver_001",
+    "solver_002",
+    "solver_003",
+};
+
+enum Counter {
+    anneal_iterations,
+    anneal_accepted,
+    restarts,
+    beam_nodes,
+    counter_count,
+};
+
+constexpr const char* counter_names[counter_count] = {
+    "anneal_iterations",
+    "anneal_accepted",
+    "restarts",
+    "beam_nodes",
+};
+
+struct Table {
+    long long calls[phase_count] = {};
+    double time[phase_count] = {};
+    long long count[counter_count] = {};
+    void add(const Table& other) {
+        for(int k = 0; k < phase_count; k++) {
+            calls[k] += other.calls[k];
+            time[k] += other.time[k];
+        }
+        for(int k = 0; k < counter_count; k++) {
+            count[k] += other.count[k];
+        }
+    }
+};
+
+// totals of exited threads plus the tables of the live ones
+struct Registry {
+    mutex mtx;
+    Table retired;
+    vector<const Table*> live;
+};
+
+Registry& registry() {
+    static Registry reg;
+    return reg;
+}
+
+struct LocalTable : Table {
+    LocalTable() {
+        Registry& reg = registry();
+        lock_guard<mutex> lock(reg.mtx);
+        reg.live.push_back(this);
+    }
+    ~LocalTable() {
+        Registry& reg = registry();
+        lock_guard<mutex> lock(reg.mtx);
+        reg.retired.add(*this);
+        erase(reg.live, this);
+    }
+};
+
+Table& local() {
+    thread_local LocalTable table;
+    return table;
+}
+
+struct Scope {
+    Phase phase;
+    double start;
+    explicit Scope(Phase _phase) : phase(_phase), start(toki.gettime()) {}
+    ~Scope() {
+        Table& table = local();
+        table.calls[phase]++;
+        table.time[phase] += toki.gettime() - start;
+    }
+};
+
+// call once every worker thread has been joined; live tables are read without synchronization
+void report(ostream& os) {
+#ifdef AHC_PROFILE
+    Registry& reg = registry();
+    lock_guard<mutex> lock(reg.mtx);
+    Table total = reg.retired;
+    for(const Table* table : reg.live) {
+        total.add(*table);
+    }
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << fixed << setprecision(6);
+    for(int k = 0; k < phase_count; k++) {
+        os << "profile_" << phase_names[k] << "_calls = " << total.calls[k] << "\n";
+        os << "profile_" << phase_names[k] << "_time = " << total.time[k] << "\n";
+    }
+    for(int k = 0; k < counter_count; k++) {
+        os << "profile_" << counter_names[k] << "_count = " << total.count[k] << "\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+    os.flush();
+#else
+    (void)os;
+#endif
+}
+
+} // namespace profile
+
+#ifdef AHC_PROFILE
+#define PROFILE_SCOPE(phase) const profile::Scope profile_scope(profile::phase)
+#define PROFILE_COUNT(counter) (profile::local().count[profile::counter]++)
+#else
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_COUNT(counter) ((void)0)
+#endif
+
+#endif
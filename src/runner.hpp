@@ -0,0 +1,157 @@
+#ifndef __RUNNER_HPP__
+#define __RUNNER_HPP__
+
+#include "common.hpp"
+#include "ryuka.hpp"
+#include "toki.hpp"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <glob.h>
+#include <string>
+#include <thread>
+
+extern thread_local Input in;
+extern Timer toki;
+
+// batch mode: solves many input files in one process on a pool of threads, writes one
+// output per input and a csv of score, turns and wall time per instance.
+namespace runner {
+
+struct Options {
+    string pattern;             // directory (every *.txt in it) or glob
+    string out_dir = "out";
+    string csv_path;            // default: <out_dir>/results.csv
+    int threads = thread::hardware_concurrency();   // budget of the whole batch
+    int instance_threads = 1;   // of the budget, what one instance's solve gets; threads / instance_threads instances run at once
+    double time_limit = 2.5;    // seconds per instance
+};
+
+struct Row {
+    string name;
+    long long score;
+    int turns;
+    double time;
+};
+
+// solve(deadline, threads) runs on the calling thread with in and ryuka already set up,
+// and may keep threads threads busy, its own included
+using Solve = function<vector<vector<ActionType>>(double deadline, int threads)>;
+
+vector<string> collect_inputs(const string& pattern) {
+    vector<string> res;
+    if(filesystem::is_directory(pattern)) {
+        for(const auto& entry : filesystem::directory_iterator(pattern)) {
+            if(entry.is_regular_file() && entry.path().extension() == ".txt") {
+                res.push_back(entry.path().string());
+            }
+        }
+    } else {
+        glob_t g;
+        if(glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+            for(size_t k = 0; k < g.gl_pathc; k++) {
+                res.push_back(g.gl_pathv[k]);
+            }
+        }
+        globfree(&g);
+    }
+    sort(res.begin(), res.end());
+    return res;
+}
+
+// parses "--batch <pattern> [--out dir] [--csv path] [--threads k] [--instance-threads k] [--time sec]";
+// false on bad usage
+bool parse(int argc, char** argv, Options& opt) {
+    for(int k = 1; k < argc; k++) {
+        const string key = argv[k];
+        if(k + 1 >= argc) {
+            return false;
+        }
+        const string value = argv[++k];
+        if(key == "--batch") opt.pattern = value;
+        else if(key == "--out") opt.out_dir = value;
+        else if(key == "--csv") opt.csv_path = value;
+        else if(key == "--threads") opt.threads = max(1, atoi(value.c_str()));
+        else if(key == "--instance-threads") opt.instance_threads = max(1, atoi(value.c_str()));
+        else if(key == "--time") opt.time_limit = atof(value.c_str());
+        else return false;
+    }
+    if(opt.csv_path.empty()) {
+        opt.csv_path = opt.out_dir + "/results.csv";
+    }
+    return !opt.pattern.empty();
+}
+
+// instance k is seeded with RandGenerator::derive(seed, k), so a batch is reproducible
+// up to timing. returns the number of instances solved.
+int run(const Options& opt, uint64_t seed, const Solve& solve) {
+    const vector<string> files = collect_inputs(opt.pattern);
+    filesystem::create_directories(opt.out_dir);
+    vector<Row> rows(files.size());
+    atomic<int> next_file(0);
+    // an instance never gets more than the whole budget
+    const int instance_threads = max(1, min(opt.instance_threads, opt.threads));
+    auto worker = [&]() {
+        for(int k = next_file++; k < (int)files.size(); k = next_file++) {
+            ifstream ifs(files[k]);
+            in.read(ifs);
+            ryuka.init(RandGenerator::derive(seed, k));
+            const double start = toki.elapsed();
+            const vector<vector<ActionType>> ans = solve(start + opt.time_limit, instance_threads);
+            Row& row = rows[k];
+            row.name = filesystem::path(files[k]).filename().string();
+            row.time = toki.elapsed() - start;
+            row.score = common::score(in, ans);
+            row.turns = 0;
+            for(const auto& line : ans) {
+                row.turns = max(row.turns, (int)count_if(line.begin(), line.end(), [](ActionType act) { return act != ActionType::DESTROYED; }));
+            }
+            ofstream ofs(opt.out_dir + "/" + row.name);
+            common::print(ans, ofs);
+        }
+    };
+    vector<thread> pool;
+    for(int t = 0; t < max(1, opt.threads / instance_threads); t++) {
+        pool.emplace_back(worker);
+    }
+    for(thread& th : pool) {
+        th.join();
+    }
+
+    ofstream csv(opt.csv_path);
+    csv << "input,score,turns,time\n";
+    for(const Row& row : rows) {
+        csv << row.name << "," << row.score << "," << row.turns << "," << fixed << setprecision(4) << row.time << "\n";
+    }
+
+    // key = value lines, as run.py's results_summary reports them
+    if(!rows.empty()) {
+        double mean = 0, var = 0, max_time = 0;
+        int best = 0, worst = 0;
+        for(int k = 0; k < (int)rows.size(); k++) {
+            mean += (double)rows[k].score / rows.size();
+            max_time = max(max_time, rows[k].time);
+            if(rows[k].score < rows[best].score) best = k;
+            if(rows[k].score > rows[worst].score) worst = k;
+        }
+        for(const Row& row : rows) {
+            var += (row.score - mean) * (row.score - mean) / max(1, (int)rows.size() - 1);
+        }
+        cout << "instances = " << rows.size() << "\n";
+        cout << fixed << setprecision(4);
+        cout << "score_mean = " << mean << "\n";
+        cout << "score_min = " << rows[best].score << "\n";
+        cout << "score_min_input = " << rows[best].name << "\n";
+        cout << "score_max = " << rows[worst].score << "\n";
+        cout << "score_max_input = " << rows[worst].name << "\n";
+        cout << "score_stdev = " << sqrt(var) << "\n";
+        cout << "max_time = " << max_time << endl;
+    }
+    return rows.size();
+}
+
+} // namespace runner
+
+#endif
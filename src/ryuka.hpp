@@ -9,9 +9,29 @@ struct RandGenerator {
     random_device seed_gen;
     mt19937 engine;
     mt19937_64 engine64;
+    uint64_t seed;
     static const int pshift = 1000000000;
     
-    RandGenerator() : engine(seed_gen()), engine64(seed_gen()) {}
+    RandGenerator() {
+        init((uint64_t)seed_gen() << 32 | seed_gen());
+    }
+
+    // reseeds both engines from one value, so a run can be reproduced from seed
+    void init(uint64_t _seed) {
+        seed = _seed;
+        seed_seq seq{(uint32_t)seed, (uint32_t)(seed >> 32)};
+        seed_seq seq64{(uint32_t)(seed >> 32), (uint32_t)seed, 1u};
+        engine.seed(seq);
+        engine64.seed(seq64);
+    }
+    
+    // seed of stream k derived from a master seed (splitmix64), for reproducible parallel runs
+    static uint64_t derive(uint64_t master, uint64_t k) {
+        uint64_t z = master + 0x9e3779b97f4a7c15ull * (k + 1);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
     
     int rand(int mod) {
         return engine() % mod;
@@ -28,6 +48,9 @@ struct RandGenerator {
         return rand(pshift) < p_int;
     }
 
-} ryuka;
+};
+
+// one generator per thread, so solvers can run concurrently
+thread_local RandGenerator ryuka;
 
 #endif
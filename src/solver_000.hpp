@@ -2,11 +2,12 @@
 #define __SOLVER_000_HPP__
 
 #include "common.hpp"
+#include "anytime.hpp"
 #include <numeric>
 #include <algorithm>
 #include <set>
 
-extern Input in;
+extern thread_local Input in;
 
 
 namespace solver_000 {
@@ -48,16 +49,16 @@ vector<vector<ActionType>> solve() {
             if(k == 0) {
                 act = ActionType::CATCH;
                 for(int i = 0; i < n; i++) {
-                    assert(term.cranes[i]->i == i);
-                    assert(term.cranes[i]->j == 0);
+                    assert(term.cranes[i].i == i);
+                    assert(term.cranes[i].j == 0);
                 }
             } else if(1 <= k && k <= m1) {
                 act = ActionType::RIGHT;
             } else if(k == m2) {
                 act = ActionType::RELEASE;
                 for(int i = 0; i < n; i++) {
-                    assert(term.cranes[i]->i == i);
-                    assert(term.cranes[i]->j == j);
+                    assert(term.cranes[i].i == i);
+                    assert(term.cranes[i].j == j);
                 }
             } else if(m2+1 <= k && k <= m3) {
                 act = ActionType::LEFT;
@@ -89,13 +90,11 @@ vector<vector<ActionType>> solve() {
         vector<int> next_c(n, 100);
         set<int> remains;
         for(int i = 0; i < n*n; i++) remains.insert(i);
-        for(int i = 0; i < n; i++) {
-            for(auto p: term.collected_containers[i]) {
-                remains.erase(p->id);
-            }
+        for(int k = 0; k < term.collected_count; k++) {
+            remains.erase(term.collected[k]);
         }
         if(remains.empty()) {
-            cerr << "all containers gone" << endl;
+            LOG_DEBUG("all containers gone");
             break;
         }
         for(int id: remains) {
@@ -108,7 +107,7 @@ vector<vector<ActionType>> solve() {
         for(int i = 0; i < n; i++) {
             for(int j = 0; j < n-1; j++) {
                 for(int k = 0; k < n; k++) {
-                    if(term.container_pos[i][j] && term.container_pos[i][j]->id == next_c[k]) {
+                    if(term.container_at(i, j) == next_c[k]) {
                         c = next_c[k];
                         break;
                     }
@@ -120,30 +119,29 @@ vector<vector<ActionType>> solve() {
 
         // 順番以外の場合はとりあえず、終了にする
         if(c == -1) {
-            cerr << "cannot found target container (c=-1)" << endl;
+            LOG_WARN("cannot found target container (c=-1)");
             break;
         }
 
-        cerr << "c = " << c << endl;
+        LOG_DEBUG("c = " << c);
 
         auto catch_and_release = [&](int c, int goal_i, int goal_j) -> void {
 
             // 移動させるコンテナの場所まで移動する。
             {
-                const int next_i = term.containers[c]->i;
-                const int next_j = term.containers[c]->j;
-                while(next_i != term.cranes[0]->i) {
+                const auto [next_i, next_j] = term.find_container(c);
+                while(next_i != term.cranes[0].i) {
                     vector<ActionType> actions(n, ActionType::DESTROYED);
-                    const ActionType act = (next_i > term.cranes[0]->i ? ActionType::DOWN : ActionType::UP);
+                    const ActionType act = (next_i > term.cranes[0].i ? ActionType::DOWN : ActionType::UP);
                     actions[0] = act;
                     term.update1();
                     term.update2(actions);
                     copy2res(res, actions);
                     term.update3();
                 }
-                while(next_j != term.cranes[0]->j) {
+                while(next_j != term.cranes[0].j) {
                     vector<ActionType> actions(n, ActionType::DESTROYED);
-                    const ActionType act = (next_j > term.cranes[0]->j ? ActionType::RIGHT : ActionType::LEFT);
+                    const ActionType act = (next_j > term.cranes[0].j ? ActionType::RIGHT : ActionType::LEFT);
                     actions[0] = act;
                     term.update1();
                     term.update2(actions);
@@ -166,18 +164,18 @@ vector<vector<ActionType>> solve() {
             {
                 const int next_i = goal_i;
                 const int next_j = goal_j;
-                while(next_i != term.cranes[0]->i) {
+                while(next_i != term.cranes[0].i) {
                     vector<ActionType> actions(n, ActionType::DESTROYED);
-                    const ActionType act = (next_i > term.cranes[0]->i ? ActionType::DOWN : ActionType::UP);
+                    const ActionType act = (next_i > term.cranes[0].i ? ActionType::DOWN : ActionType::UP);
                     actions[0] = act;
                     term.update1();
                     term.update2(actions);
                     copy2res(res, actions);
                     term.update3();
                 }
-                while(next_j != term.cranes[0]->j) {
+                while(next_j != term.cranes[0].j) {
                     vector<ActionType> actions(n, ActionType::DESTROYED);
-                    const ActionType act = (next_j > term.cranes[0]->j ? ActionType::RIGHT : ActionType::LEFT);
+                    const ActionType act = (next_j > term.cranes[0].j ? ActionType::RIGHT : ActionType::LEFT);
                     actions[0] = act;
                     term.update1();
                     term.update2(actions);
@@ -198,24 +196,29 @@ vector<vector<ActionType>> solve() {
         };
 
         // step 3
-        const int catch_i = term.containers[c]->i;
-        const int catch_j = term.containers[c]->j;
-        catch_and_release(c, term.containers[c]->out_i, n-1);
+        const auto [catch_i, catch_j] = term.find_container(c);
+        catch_and_release(c, common::calc_out_i(c), n-1);
 
         // step 4
         for(int i = 0; i < n; i++) {
-            if(term.container_pos[i][0] && !term.container_queue[i].empty()
-                && !term.container_pos[catch_i][catch_j]) {
-                catch_and_release(term.container_pos[i][0]->id, catch_i, catch_j);
+            if(term.has_container(i, 0) && !term.queue_empty(i)
+                && !term.has_container(catch_i, catch_j)) {
+                catch_and_release(term.container_at(i, 0), catch_i, catch_j);
             }
         }
         
-        cerr << "turn_count = " << term.turn_count << endl;
+        LOG_DEBUG("turn_count = " << term.turn_count);
     }
     return res;
 
 }
 
+// 一度きりの貪欲なので、終わったら結果を出すだけ
+void solve(const Context& ctx, double, Incumbent& incumbent) {
+    PROFILE_SCOPE(solver_000);
+    incumbent.publish(ctx, solve());
+}
+
 } // namespace solver_000
 
 #endif
\ No newline at end of file
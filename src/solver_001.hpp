@@ -3,171 +3,317 @@
 
 #include "common.hpp"
 #include "ryuka.hpp"
+#include "planner.hpp"
+#include "packed.hpp"
+#include "toki.hpp"
+#include "anytime.hpp"
+#include "assignment.hpp"
 #include <numeric>
 #include <algorithm>
 #include <set>
+#include <atomic>
+#include <thread>
 
-extern Input in;
-extern RandGenerator ryuka;
+extern thread_local Input in;
+extern thread_local RandGenerator ryuka;
+extern Timer toki;
 
 namespace sovler_001 {
 
+// 小クレーンがコンテナを持ったまま動けないターン数の上限
+constexpr int stuck_turns = 3;
+// だれもつかむ・置くをしないターンがこれだけ続くたびに、行き詰まりとみなして立て直す。
+// 毎ターン立て直すと、割り当てと経路が変わり続けて、かえって何も進まない
+constexpr int stall_turns = 8;
+// solve_restarts の既定の試行回数と、タスク選択に加えるゆらぎの幅
+constexpr int restart_count = 128;
+constexpr int task_noise = 2;
+// 割り当てで、搬出口へ運ぶタスク（large_job）を優先する度合い
+constexpr int large_job_bonus = 20;
+
+// 先読みで試すタスクの数と、先読みするターン数。width が 1 以下なら先読みしない
+struct Lookahead {
+    int width, horizon;
+};
+constexpr Lookahead max_lookahead = {2, 60};
+// 残り時間がこれを切ったら、先読みを残り時間に比例して小さくする
+constexpr double lookahead_budget = 1.0;
+
+Lookahead lookahead_for(double remaining) {
+    const double x = clamp(remaining / lookahead_budget, 0.0, 1.0);
+    return Lookahead{(int)lround(1 + (max_lookahead.width - 1) * x), (int)lround(max_lookahead.horizon * x)};
+}
+
 struct CR_task {
     int catch_i, catch_j;
     int release_i, release_j;
     bool large_job;
+    CR_task() = default;
     CR_task(int catch_i, int catch_j, int release_i, int release_j, bool large_job) : 
         catch_i(catch_i), catch_j(catch_j), release_i(release_i), release_j(release_j), large_job(large_job) {}
 };
 
-void copy2res(vector<vector<ActionType>>& res, const vector<ActionType>& actions) {
-    for(int i = 0; i < n; i++) {
-        res[i].push_back(actions[i]);
+// 移動タスクの登録簿。ハンドル（スロット番号）は削除されるまで変わらない。
+// 追加順の双方向リストでたどれるので、反復順は以前の vector と同じ。
+// つかむマスと置くマスの予約を大・小のジョブ別にマス単位で持ち、予約の判定は O(1)。
+struct TaskRegistry {
+    // つかむマスはジョブの種類ごとに重ならないので、登録数は 2*n*n 以下
+    static constexpr int capacity = 64;
+    static constexpr int nil = -1;
+    CR_task tasks[capacity];
+    int8_t prev[capacity], next[capacity];
+    int8_t catch_owner[2][n*n];         // [large_job][cell]: そのマスをつかむタスク、なければ nil
+    uint8_t release_count[2][n*n];
+    uint32_t catch_mask[2], release_mask[2];
+    uint64_t free_slots;
+    int head, tail, count;
+
+    struct iterator {
+        const TaskRegistry* registry;
+        int t;
+        int operator*() const { return t; }
+        iterator& operator++() { t = registry->next[t]; return *this; }
+        bool operator!=(const iterator& other) const { return t != other.t; }
+    };
+
+    TaskRegistry() { clear(); }
+    void clear();
+    int size() const { return count; }
+    const CR_task& operator[](int t) const { return tasks[t]; }
+    iterator begin() const { return iterator{this, head}; }
+    iterator end() const { return iterator{this, nil}; }
+    int insert(const CR_task& cr);
+    void erase(int t);
+    int find_catch(int cell, bool large_job) const { return catch_owner[large_job][cell]; }
+    // マスがつかむ・置く場所として予約されているか。skip_large_job なら大ジョブの予約を無視する
+    bool reserved(int cell, bool skip_large_job) const {
+        uint32_t mask = catch_mask[0] | release_mask[0];
+        if(!skip_large_job) {
+            mask |= catch_mask[1] | release_mask[1];
+        }
+        return mask >> cell & 1;
     }
+};
+
+void TaskRegistry::clear() {
+    memset(catch_owner, nil, sizeof(catch_owner));
+    memset(release_count, 0, sizeof(release_count));
+    catch_mask[0] = catch_mask[1] = release_mask[0] = release_mask[1] = 0;
+    free_slots = ~0ull;
+    head = tail = nil;
+    count = 0;
 }
 
-ActionType get_next_action(int i, const vector<vector<shared_ptr<Crane>>>& next_crane_pos, const Terminal& term, const vector<vector<ActionType>>& res) {
-    shared_ptr<Crane> crane = term.cranes[i];
+int TaskRegistry::insert(const CR_task& cr) {
+    assert(free_slots != 0);
+    const int t = countr_zero(free_slots);
+    free_slots &= free_slots - 1;
+    tasks[t] = cr;
+    prev[t] = tail;
+    next[t] = nil;
+    if(tail == nil) {
+        head = t;
+    } else {
+        next[tail] = t;
+    }
+    tail = t;
+    count++;
+    const int c = cr.catch_i*n + cr.catch_j;
+    const int r = cr.release_i*n + cr.release_j;
+    assert(catch_owner[cr.large_job][c] == nil);
+    catch_owner[cr.large_job][c] = t;
+    catch_mask[cr.large_job] |= 1u << c;
+    release_count[cr.large_job][r]++;
+    release_mask[cr.large_job] |= 1u << r;
+    return t;
+}
+
+void TaskRegistry::erase(int t) {
+    const CR_task& cr = tasks[t];
+    const int c = cr.catch_i*n + cr.catch_j;
+    const int r = cr.release_i*n + cr.release_j;
+    catch_owner[cr.large_job][c] = nil;
+    catch_mask[cr.large_job] &= ~(1u << c);
+    if(--release_count[cr.large_job][r] == 0) {
+        release_mask[cr.large_job] &= ~(1u << r);
+    }
+    if(prev[t] == nil) {
+        head = next[t];
+    } else {
+        next[prev[t]] = next[t];
+    }
+    if(next[t] == nil) {
+        tail = prev[t];
+    } else {
+        prev[next[t]] = prev[t];
+    }
+    free_slots |= 1ull << t;
+    count--;
+}
+
+// next_cell は Planner が決めた次ターンの位置。reserved はタスクやクレーンがつかむ・置く場所として
+// 予約しているマス（Dispatcher::reserved_cells）
+ActionType get_next_action(int i, int next_cell, int stay_count, uint32_t reserved, const Terminal& term, const PackedActions& res) {
+    PROFILE_SCOPE(get_next_action);
+    const Crane* crane = &term.cranes[i];
     // すでに爆破済みの場合
     if(!crane->exist) {
         return ActionType::DESTROYED;
     }
-    // その場でキープしていることが邪魔になる場合、四方向で移動できる方向に移動する
-    auto random_walk = [&]() -> ActionType {
-        constexpr int di[4] = {1, -1,  0, 0};
-        constexpr int dj[4] = {0,  0, -1, 1};
-        vector<int> k_idx = {0, 1, 2, 3};
-        shuffle(k_idx.begin(), k_idx.end(), ryuka.engine);
-        constexpr ActionType act_types[4] = {ActionType::DOWN, ActionType::UP, ActionType::LEFT, ActionType::RIGHT};
-        for(int k : k_idx) {
-            const int next_i = crane->i + di[k];
-            const int next_j = crane->j + dj[k];
-            if(next_i < 0 || next_j < 0 || next_i >= n || next_j >= n) continue;
-            if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                return act_types[k];
-            }
-        }
-        // 一つも移動先がない場合、あきらめて爆破する
-        return ActionType::BOMB;
-    };       
+    const int cur = crane->i*n + crane->j;
+    auto move_to_next = [&]() -> ActionType {
+        if(next_cell == cur + n) return ActionType::DOWN;
+        if(next_cell == cur - n) return ActionType::UP;
+        if(next_cell == cur + 1) return ActionType::RIGHT;
+        if(next_cell == cur - 1) return ActionType::LEFT;
+        return ActionType::WAIT;
+    };
     // することがない場合
     if(crane->status == CraneStatus::FREE) {
-        assert(!crane->container);
-        // することがなければ、その場をキープ
-        /*
-        if(!next_crane_pos[crane->i][crane->j]) {
-            return ActionType::WAIT;
-        }
-        */
+        assert(crane->container == -1);
         // 残りのコンテナの数よりクレーンが大きければ爆破
-        int container_count = 0;
-        for(int i = 0; i < n; i++) {
-            for(int j = 0; j < n; j++) {
-                if(term.container_pos[i][j]) {
-                    container_count++;
-                }
-            }
-        }
+        const int container_count = popcount(term.container_mask);
         int crane_count = 0;
         for(int i = 0; i < n; i++) {
-            if(term.cranes[i]->exist) {
+            if(term.cranes[i].exist) {
                 crane_count++;
             }
         }
         if(container_count < crane_count && i != 0) {
             return ActionType::BOMB;
         }
-        return random_walk();
+        // 他のクレーンの進路にいる場合は Planner がよけさせる
+        return move_to_next();
     }
     // CATCHに向かっている場合
     else if(crane->status == CraneStatus::PRE_CATCH) {
-        const int di = crane->catch_i - crane->i;
-        const int dj = crane->catch_j - crane->j;
-        const int ord = ryuka.rand(2);
-        for(int k = 0; k < 2; k++) {
-            if(di != 0 && k == ord) {
-                const int next_i = crane->i + (di > 0 ? 1 : -1);
-                const int next_j = crane->j;
-                if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                    return (di > 0 ? ActionType::DOWN : ActionType::UP);
-                }
-            }
-            if(dj != 0 && k != ord) {
-                const int next_i = crane->i;
-                const int next_j = crane->j + (dj > 0 ? 1 : -1);
-                if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                    return (dj > 0 ? ActionType::RIGHT : ActionType::LEFT);
-                }
-            }
-        }
-        if(di == 0 && dj == 0) {
+        if(crane->i == crane->catch_i && crane->j == crane->catch_j && next_cell == cur) {
             return ActionType::CATCH;
         }
-        // 大クレーンの進路を妨げている場合、リリースさせる
-        if(crane->crane_type == CraneType::SMALL) {
-            return random_walk();
-        }
-        return ActionType::WAIT;
+        return move_to_next();
     } 
     else if(crane->status == CraneStatus::CATCH_NOW) {
         assert(crane->i == crane->catch_i && crane->j == crane->catch_j);
-        if(!term.container_pos[crane->i][crane->j]) {
-            cerr << crane->i << ", " << crane->j << endl;
-            common::print(res);
+        if(!term.has_container(crane->i, crane->j)) {
+            LOG_ERROR("no container to catch at " << (int)crane->i << ", " << (int)crane->j);
+            res.print();
         }
-        assert(term.container_pos[crane->i][crane->j]);
-        assert(!crane->container);
+        assert(term.has_container(crane->i, crane->j));
+        assert(crane->container == -1);
         return ActionType::CATCH;
     }
     else if(crane->status == CraneStatus::PRE_RELEASE) {
-        const int di = crane->release_i - crane->i;
-        const int dj = crane->release_j - crane->j;
-        const int ord = ryuka.rand(2);
-        for(int k = 0; k < 2; k++) {
-            if(di != 0 && k == ord) {
-                const int next_i = crane->i + (di > 0 ? 1 : -1);
-                const int next_j = crane->j;
-                if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                    return (di > 0 ? ActionType::DOWN : ActionType::UP);
-                }
-            }
-            if(dj != 0 && k != ord) {
-                const int next_i = crane->i;
-                const int next_j = crane->j + (dj > 0 ? 1 : -1);
-                if(!term.crane_pos[next_i][next_j] && !next_crane_pos[next_i][next_j]) {
-                    return (dj > 0 ? ActionType::RIGHT : ActionType::LEFT);
-                }
-            }
-        }
-        if(di == 0 && dj == 0) {
+        if(crane->i == crane->release_i && crane->j == crane->release_j && next_cell == cur) {
             return ActionType::RELEASE;
         }
-        // 大クレーンの進路を妨げている場合、リリースさせる
-        if(crane->crane_type == CraneType::SMALL) {
-            if(crane->container) {
-                return ActionType::RELEASE;
-            }
-            return random_walk();
+        // 小クレーンが長く動けない場合、その場でリリースさせる（搬出口と、ほかの置き場所として予約されたマスは除く）
+        if(crane->crane_type == CraneType::SMALL && next_cell == cur && stay_count >= stuck_turns
+            && crane->j != n-1 && !term.has_container(crane->i, crane->j) && !(reserved >> cur & 1)) {
+            return ActionType::RELEASE;
         }
-        return ActionType::WAIT;
+        return move_to_next();
     }
     else if(crane->status == CraneStatus::RELEASE_NOW) {
         assert(crane->i == crane->release_i && crane->j == crane->release_j);
-        assert(crane->container);
+        assert(crane->container != -1);
         return ActionType::RELEASE;
     }
 
-    cerr << "get_next_action: failed to find next action" << endl;
+    LOG_WARN("get_next_action: failed to find next action");
     return ActionType::WAIT;
 }
 
 
-vector<vector<ActionType>> solve() {
+// 大きいほど良い。搬出済みの数、誤搬出と順序の逆転、次に搬出すべきコンテナの詰まり具合で評価する
+long long evaluate(const Terminal& term) {
+    long long delivered = 0, wrong = 0, inversions = 0;
+    bool gone[n*n] = {};
+    for(int a = 0; a < term.collected_count; a++) {
+        gone[term.collected[a]] = true;
+        if(common::calc_out_i(term.collected[a]) != term.collected_row[a]) {
+            wrong++;
+        } else {
+            delivered++;
+        }
+        for(int b = a+1; b < term.collected_count; b++) {
+            if(term.collected_row[a] == term.collected_row[b] && term.collected[a] > term.collected[b]) {
+                inversions++;
+            }
+        }
+    }
+    // blocking depth: 次に搬出すべきコンテナが搬出口に届くまでの距離の目安
+    long long blocking = 0;
+    for(int r = 0; r < n; r++) {
+        int c = -1;
+        for(int id = r*n; id < (r+1)*n; id++) {
+            if(!gone[id]) {
+                c = id;
+                break;
+            }
+        }
+        if(c == -1) {
+            continue;
+        }
+        const auto [ci, cj] = term.find_container(c);
+        if(ci != -1) {
+            blocking += abs(ci - r) + (n-1 - cj);
+            continue;
+        }
+        for(int q = 0; q < n; q++) {
+            for(int p = term.queue_head[q]; p < n; p++) {
+                if(term.queue[q][p] == c) {
+                    blocking += 4 * (p - term.queue_head[q] + 1) + abs(q - r) + (n-1);
+                }
+            }
+        }
+    }
+    return 100*delivered - 10000*wrong - 100*inversions - 5*blocking;
+}
 
-    vector<vector<ActionType>> res(n);
-    
+// solver_001 の1ターン分の処理をまとめたもの。
+// 値としてコピーできるので、solver_002 のビームサーチで分岐させられる。
+struct Dispatcher {
     Terminal term;
-    term.init(in);    
+    TaskRegistry cr_tasks;
+    uint32_t crane_reserved;            // クレーンが受け持っているタスクのつかむ・置くマス
+    Planner planner;
+    int stay_count[n];
+    int stall_count;                    // だれもつかむ・置くをしていないターン数
+    PackedActions res;
+    bool verbose;
+    Lookahead lookahead;
+    void init(const Input&, bool verbose);
+    bool finished() const { return term.remaining_containers() == 0; }
+    bool stalled() const { return stall_count > 0 && stall_count % stall_turns == 0; }
+    void erase_cr_tasks(int catch_i, int catch_j);
+    bool check_conflict(int i, int j, bool skip_large_job = false) const;
+    void update_crane_reserved();
+    uint32_t reserved_cells() const;
+    void update_cr_tasks(const vector<int>& next_c);
+    vector<int> next_containers() const;
+    bool begin_turn();
+    void unstick();
+    int task_cost(int i, int t) const;
+    int best_task(int i, mt19937* engine = nullptr) const;
+    int assignment_cost(int i, int t) const;
+    long long rollout(int i, int t) const;
+    void assign_by_lookahead();
+    void assign(int i, int t);
+    void assign_free_cranes(mt19937* engine = nullptr);
+    void plan_paths(mt19937& engine);
+    void end_turn(mt19937& engine);
+};
+
+void Dispatcher::init(const Input& in, bool _verbose) {
+    verbose = _verbose;
+    lookahead = Lookahead{0, 0};
+    term.init(in);
+    cr_tasks.clear();
+    crane_reserved = 0;
+    planner = Planner();
+    fill(stay_count, stay_count+n, 0);
+    stall_count = 0;
+    res = PackedActions();
 
     // 1. すべてのクレーンを使って、4つを倉庫内に並べる（3+2+1ターン）
     // (廃止) 2. 小クレーンはこの時点で爆破する
@@ -193,23 +339,23 @@ vector<vector<ActionType>> solve() {
             if(k == 0) {
                 act = ActionType::CATCH;
                 for(int i = 0; i < n; i++) {
-                    assert(term.cranes[i]->i == i);
-                    assert(term.cranes[i]->j == 0);
+                    assert(term.cranes[i].i == i);
+                    assert(term.cranes[i].j == 0);
                 }
             } else if(1 <= k && k <= m1) {
                 act = ActionType::RIGHT;
             } else if(k == m2) {
                 act = ActionType::RELEASE;
                 for(int i = 0; i < n; i++) {
-                    assert(term.cranes[i]->i == i);
-                    assert(term.cranes[i]->j == j);
+                    assert(term.cranes[i].i == i);
+                    assert(term.cranes[i].j == j);
                 }
             } else if(m2+1 <= k && k <= m3) {
                 act = ActionType::LEFT;
             }
 
             vector<ActionType> actions(n, act);
-            copy2res(res, actions);
+            res.push_back(actions);
             term.update2(actions);            
             term.update3();
         }
@@ -223,204 +369,511 @@ vector<vector<ActionType>> solve() {
         for(int i = 1; i < n; i++) {
             actions[i] = ActionType::BOMB;
         }
-        copy2res(res, actions);
+        res.push_back(actions);
         term.update2(actions);
         term.update3();
     }
     */
+}
 
-    vector<CR_task> cr_tasks;
-    auto erase_cr_tasks = [&](int catch_i, int catch_j) -> void {
-        vector<CR_task> new_cr_tasks;
-        for(const CR_task cr: cr_tasks) {
-            if(cr.catch_i == catch_i && cr.catch_j == catch_j) {
-                ;
-            } else {
-                new_cr_tasks.push_back(cr);
-            }
+void Dispatcher::erase_cr_tasks(int catch_i, int catch_j) {
+    for(const bool large_job : {false, true}) {
+        const int t = cr_tasks.find_catch(catch_i*n + catch_j, large_job);
+        if(t != TaskRegistry::nil) {
+            cr_tasks.erase(t);
         }
-        swap(new_cr_tasks, cr_tasks);
-    };
+    }
+}
 
-    auto check_conflict = [&](int i, int j, bool skip_large_job = false) -> bool {
-        for(const CR_task cr : cr_tasks) {
-            if(skip_large_job && cr.large_job) {
-                continue;
-            }
-            if(cr.catch_i == i && cr.catch_j == j) {
-                return false;
+bool Dispatcher::check_conflict(int i, int j, bool skip_large_job) const {
+    const int cell = i*n + j;
+    return !cr_tasks.reserved(cell, skip_large_job) && !(crane_reserved >> cell & 1);
+}
+
+void Dispatcher::update_crane_reserved() {
+    crane_reserved = 0;
+    for(const Crane& c : term.cranes) {
+        if(c.status != CraneStatus::FREE && c.exist) {
+            if( c.status == CraneStatus::PRE_CATCH || c.status == CraneStatus::CATCH_NOW) {
+                crane_reserved |= 1u << (c.catch_i*n + c.catch_j);
             }
-            if(cr.release_i == i && cr.release_j == j) {
-                return false;
+            crane_reserved |= 1u << (c.release_i*n + c.release_j);
+        }
+    }
+}
+
+// check_conflict が false になるマスの集合。crane_reserved は update_crane_reserved の時点のもの
+uint32_t Dispatcher::reserved_cells() const {
+    return cr_tasks.catch_mask[0] | cr_tasks.catch_mask[1] | cr_tasks.release_mask[0] | cr_tasks.release_mask[1] | crane_reserved;
+}
+
+void Dispatcher::update_cr_tasks(const vector<int>& next_c) {
+    PROFILE_SCOPE(update_cr_tasks);
+    // この関数の中ではクレーンの受け持ちは変わらないので、予約は最初にまとめて作る
+    update_crane_reserved();
+    // 搬出待ちのコンテナを移動させる
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n-1; j++) {
+            for(int r = 0; r < n; r++) {
+                if(check_conflict(i, j) && term.container_at(i, j) == next_c[r]) {
+                    cr_tasks.insert(CR_task(i, j, common::calc_out_i(next_c[r]), n-1, true));
+                    break;
+                }   
             }
         }
-        for(const shared_ptr<Crane> c : term.cranes) {
-            if(c->status != CraneStatus::FREE && c->exist) {
-                if( c->status == CraneStatus::PRE_CATCH || c->status == CraneStatus::CATCH_NOW) {
-                    if(c->catch_i == i && c->catch_j == j) {
-                        return false;
+    }
+    // 空いているマスに上下で移動できるものがあれば移動させる
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n-1; j++) {
+            if(check_conflict(i, j) && !term.has_container(i, j) && !term.has_crane(i, j)) {
+                constexpr int di[2] = {1, -1};
+                constexpr int dj[2] = {0,  0};
+                for(int k = 0; k < 2; k++) {
+                    const int adj_i = i + di[k];
+                    const int adj_j = j + dj[k];
+                    auto is_closer_than_cur = [&](int out_i, int cur_i, int next_i) -> bool {
+                        const int diff_cur = abs(out_i - cur_i);
+                        const int diff_next = abs(out_i - next_i);
+                        return diff_next < diff_cur;
+                    };
+                    if( adj_i >= 0 && adj_j >= 0 && adj_i < n && adj_j < n &&
+                        term.has_container(adj_i, adj_j) &&
+                        check_conflict(adj_i, adj_j, true) &&
+                        (is_closer_than_cur(common::calc_out_i(term.container_at(adj_i, adj_j)), adj_i, i) || !term.queue_empty(i))) 
+                    {
+                        cr_tasks.insert(CR_task(adj_i, adj_j, i, j, false));
+                        break;
                     }
                 }
-                if(c->release_i == i && c->release_j == j) {
-                    return false;
+            }
+        }
+    }
+    // 左から右へ移動させることができる場合、移動させる。
+    for(int i = 0; i < n; i++) {
+        for(int j = 1; j < n-1; j++) {
+            if(check_conflict(i, j) && !term.has_crane(i, j) && !term.has_container(i, j)) {
+                const int adj_i = i;
+                const int adj_j = j - 1;
+                if( adj_i >= 0 && adj_j >= 0 && adj_i < n && adj_j < n &&
+                    term.has_container(adj_i, adj_j) &&
+                    check_conflict(adj_i, adj_j, true))
+                {
+                    cr_tasks.insert(CR_task(adj_i, adj_j, i, j, false));
+                    break;
                 }
             }
         }
-        return true;
-    };
+    }
+}
 
-    // iterates step3 and step4
-    while(term.turn_count < MAX_TURN) {
+// 搬出口ごとに、次に搬出すべきコンテナ（なければ 100）
+vector<int> Dispatcher::next_containers() const {
+    vector<int> next_c(n, 100);
+    bool gone[n*n] = {};
+    for(int k = 0; k < term.collected_count; k++) {
+        gone[term.collected[k]] = true;
+    }
+    for(int id = 0; id < n*n; id++) {
+        if(!gone[id]) {
+            int i = common::calc_out_i(id);
+            next_c[i] = min(next_c[i], id);
+        }
+    }
+    return next_c;
+}
+
+// ターン開始時の処理。すべてのコンテナが搬出済みなら false を返す
+bool Dispatcher::begin_turn() {
 
-        term.watch();
+    if(verbose) LOG_TRACE(term);
+
+    // 待機列
+    if(finished()) {
+        if(verbose) LOG_DEBUG("all containers gone");
+        return false;
+    }
+    const vector<int> next_c = next_containers();
 
-        // 待機列
-        vector<int> next_c(n, 100);
-        set<int> remains;
-        for(int i = 0; i < n*n; i++) remains.insert(i);
+    // 移動タスクのリストを更新する
+    // 立て直しで受け持ちを解いたクレーンのタスクも、同じターンに作り直して割り当てる
+    term.update1();
+    if(stalled()) {
+        unstick();
+    }
+    update_cr_tasks(next_c);
+    if(verbose) {
+        LOG_DEBUG("cr_tasks.size() = " << cr_tasks.size());
+        for(const int t : cr_tasks) {
+            const CR_task& cr = cr_tasks[t];
+            LOG_DEBUG(cr.catch_i << "," << cr.catch_j << "->" << cr.release_i << "," << cr.release_j);
+        }
         for(int i = 0; i < n; i++) {
-            for(auto p: term.collected_containers[i]) {
-                remains.erase(p->id);
+            LOG_DEBUG("crane #" << i << ": " << (int)term.cranes[i].status);
+        }
+    }
+    return true;
+}
+
+// 行き詰まったときの立て直し。コンテナを持っていないクレーンの受け持ちを解いて割り当て直させ、
+// 搬入を待つ列の入口をふさいでいるコンテナには、空いているマスへどかすタスクを作る。
+// 経路も、同じターンに優先順位を変えて計画し直す（plan_paths）
+void Dispatcher::unstick() {
+    for(Crane& c : term.cranes) {
+        if(c.exist && c.container == -1 && c.status == CraneStatus::PRE_CATCH) {
+            c.status = CraneStatus::FREE;
+        }
+    }
+    update_crane_reserved();
+    for(int i = 0; i < n; i++) {
+        if(term.queue_empty(i) || !term.has_container(i, 0) || !check_conflict(i, 0)) {
+            continue;
+        }
+        int best = -1, best_dist = 1 << 30;
+        for(int cell = 0; cell < n*n; cell++) {
+            const int ci = cell / n;
+            const int cj = cell % n;
+            if(cj == n-1 || (cj == 0 && !term.queue_empty(ci)) || term.has_container(ci, cj) || term.has_crane(ci, cj) || !check_conflict(ci, cj)) {
+                continue;
             }
+            const int dist = abs(ci - i) + cj;
+            if(dist < best_dist) {
+                best_dist = dist;
+                best = cell;
+            }
+        }
+        if(best != -1) {
+            cr_tasks.insert(CR_task(i, 0, best / n, best % n, false));
+        }
+    }
+}
+
+// クレーン i がタスク t を受けるコスト。受けられない場合は -1
+int Dispatcher::task_cost(int i, int t) const {
+    if(!term.has_container(cr_tasks[t].catch_i, cr_tasks[t].catch_j)) {
+        return -1;
+    }
+    if(i != 0 && cr_tasks[t].large_job) {
+        return -1;
+    }
+    // 置くマスがふさがっている（行き詰まった小クレーンがその場で置いた）タスクは受けない
+    if(term.has_container(cr_tasks[t].release_i, cr_tasks[t].release_j)) {
+        return -1;
+    }
+    int dist =  abs(term.cranes[i].i - cr_tasks[t].catch_i) +
+                abs(term.cranes[i].j - cr_tasks[t].catch_j);
+    if(term.cranes[i].prev_container_id == term.container_at(cr_tasks[t].catch_i, cr_tasks[t].catch_j)) {
+        if(term.cranes[i].crane_type == CraneType::LARGE) {
+            dist += 1000;
+        } else {
+            dist += 1000000;
         }
-        if(remains.empty()) {
-            cerr << "all containers gone" << endl;
+    }
+    return dist;
+}
+
+// engine を渡すと、コストに 0 ~ task_noise のゆらぎを加えて選ぶ
+int Dispatcher::best_task(int i, mt19937* engine) const {
+    int best_task_id = -1;
+    int min_dist = 100000;
+    for(const int t : cr_tasks) {
+        int dist = task_cost(i, t);
+        if(dist == -1) {
+            continue;
+        }
+        if(engine) {
+            dist += (*engine)() % (task_noise + 1);
+        }
+        if(min_dist > dist) {
+            min_dist = dist;
+            best_task_id = t;
+        }
+    }
+    return best_task_id;
+}
+
+void Dispatcher::assign(int i, int t) {
+    const CR_task cr = cr_tasks[t];
+    if(verbose) LOG_DEBUG("cr " << i << ":" << cr.catch_i << "," << cr.catch_j << "->" << cr.release_i << "," << cr.release_j);
+    term.cranes[i].set_catch_and_release(cr.catch_i, cr.catch_j, cr.release_i, cr.release_j);
+    erase_cr_tasks(cr.catch_i, cr.catch_j);
+}
+
+// クレーン i がタスク t を受けるときの割り当てコスト。受けられない場合は -1。
+// つかみに行く距離に、コンテナを持って置き場所まで運ぶ実際の距離を足す
+int Dispatcher::assignment_cost(int i, int t) const {
+    const int cost = task_cost(i, t);
+    // best_task と同じく、小クレーンが直前のコンテナをつかみ直すことはしない
+    if(cost == -1 || cost >= 100000) {
+        return -1;
+    }
+    const CR_task& cr = cr_tasks[t];
+    const int from = cr.catch_i*n + cr.catch_j;
+    const int to = cr.release_i*n + cr.release_j;
+    int carry = abs(cr.catch_i - cr.release_i) + abs(cr.catch_j - cr.release_j);
+    if(term.cranes[i].crane_type == CraneType::SMALL) {
+        // コンテナを持った小クレーンは、ほかのコンテナの上を通れない
+        carry = dist_cache.dist(from, to, term.container_mask & ~(1u << from));
+        if(carry == -1) {
+            return -1;
+        }
+    }
+    return cost + carry - (cr.large_job ? large_job_bonus : 0);
+}
+
+// クレーン i にタスク t を割り当てたあと、既定の割り当てで lookahead.horizon ターン進めた盤面の評価
+long long Dispatcher::rollout(int i, int t) const {
+    Dispatcher d = *this;
+    d.lookahead = Lookahead{0, 0};
+    d.verbose = false;
+    d.assign(i, t);
+    d.assign_free_cranes();
+    mt19937 engine(term.turn_count);
+    d.end_turn(engine);
+    int h = 1;
+    for(; h < lookahead.horizon; h++) {
+        if(!d.begin_turn()) {
             break;
         }
-        for(int id: remains) {
-            int i = common::calc_out_i(id);
-            next_c[i] = min(next_c[i], id);
+        d.assign_free_cranes();
+        d.end_turn(engine);
+    }
+    // 早く終わった分だけ良い
+    return evaluate(d.term) + (d.finished() ? 100LL * (lookahead.horizon - h) : 0);
+}
+
+// 最初の手持無沙汰なクレーンについて、割り当てコストの小さい lookahead.width 個のタスクを
+// 先読みで比べ、最も良いものを割り当てる
+void Dispatcher::assign_by_lookahead() {
+    PROFILE_SCOPE(lookahead);
+    for(int i = 0; i < n; i++) {
+        if(!term.cranes[i].exist || term.cranes[i].status != CraneStatus::FREE) {
+            continue;
         }
-        
-        auto update_cr_tasks = [&]() -> void {
-            // 搬出待ちのコンテナを移動させる
-            for(int i = 0; i < n; i++) {
-                for(int j = 0; j < n-1; j++) {
-                    for(int r = 0; r < n; r++) {
-                        if(check_conflict(i, j) && term.container_pos[i][j] && term.container_pos[i][j]->id == next_c[r]) {
-                            cr_tasks.push_back(CR_task(i, j, term.container_pos[i][j]->out_i, n-1, true));
-                            break;
-                        }   
-                    }
-                }
+        vector<pair<int, int>> candidates;
+        for(const int t : cr_tasks) {
+            const int cost = assignment_cost(i, t);
+            if(cost != -1) {
+                candidates.emplace_back(cost, t);
             }
-            // 空いているマスに上下で移動できるものがあれば移動させる
-            for(int i = 0; i < n; i++) {
-                for(int j = 0; j < n-1; j++) {
-                    if(check_conflict(i, j) && !term.container_pos[i][j] && !term.crane_pos[i][j]) {
-                        constexpr int di[2] = {1, -1};
-                        constexpr int dj[2] = {0,  0};
-                        for(int k = 0; k < 2; k++) {
-                            const int adj_i = i + di[k];
-                            const int adj_j = j + dj[k];
-                            auto is_closer_than_cur = [&](int out_i, int cur_i, int next_i) -> bool {
-                                const int diff_cur = abs(out_i - cur_i);
-                                const int diff_next = abs(out_i - next_i);
-                                return diff_next < diff_cur;
-                            };
-                            if( adj_i >= 0 && adj_j >= 0 && adj_i < n && adj_j < n &&
-                                term.container_pos[adj_i][adj_j] &&
-                                check_conflict(adj_i, adj_j, true) &&
-                                (is_closer_than_cur(term.container_pos[adj_i][adj_j]->out_i, adj_i, i) || !term.container_queue[i].empty())) 
-                            {
-                                cr_tasks.push_back(CR_task(adj_i, adj_j, i, j, false));
-                                break;
-                            }
-                        }
-                    }
+        }
+        if(candidates.empty()) {
+            continue;
+        }
+        const int k = min((int)candidates.size(), lookahead.width);
+        partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+        if(k >= 2) {
+            int best = candidates[0].second;
+            long long best_value = LLONG_MIN;
+            for(int c = 0; c < k; c++) {
+                const long long value = rollout(i, candidates[c].second);
+                if(value > best_value) {
+                    best_value = value;
+                    best = candidates[c].second;
                 }
             }
-            // 左から右へ移動させることができる場合、移動させる。
-            for(int i = 0; i < n; i++) {
-                for(int j = 1; j < n-1; j++) {
-                    if(check_conflict(i, j) && !term.crane_pos[i][j] && !term.container_pos[i][j]) {
-                        const int adj_i = i;
-                        const int adj_j = j - 1;
-                        if( adj_i >= 0 && adj_j >= 0 && adj_i < n && adj_j < n &&
-                            term.container_pos[adj_i][adj_j] &&
-                            check_conflict(adj_i, adj_j, true))
-                        {
-                            cr_tasks.push_back(CR_task(adj_i, adj_j, i, j, false));
-                            break;
-                        }
-                    }
-                }
+            assign(i, best);
+        }
+        return;
+    }
+}
+
+// 手持無沙汰なクレーンとタスクの組を、コスト行列の最小費用割り当てでまとめて決める。
+// 何もしないことも選べるように、クレーンの数だけ「待機」の列を足しておく。
+// engine を渡すと、コストに 0 ~ task_noise のゆらぎを加える
+void Dispatcher::assign_free_cranes(mt19937* engine) {
+    if(lookahead.width > 1 && lookahead.horizon > 0) {
+        assign_by_lookahead();
+    }
+    PROFILE_SCOPE(assign_tasks);
+    // どのタスクよりも高く、受けられないよりは安い
+    constexpr long long idle_cost = 1000000;
+    constexpr long long infeasible = 1000000000;
+    // 大小のタスクが同じマスをつかむ場合、先に割り当てた方がもう一方を消すので、
+    // 後のクレーンは残りのタスクでもう一度割り当てる。割り当てのたびにクレーンが減るので終わる
+    bool retry = true;
+    while(retry) {
+        retry = false;
+        vector<int> free_cranes, handles;
+        for(int i = 0; i < n; i++) {
+            if(term.cranes[i].exist && term.cranes[i].status == CraneStatus::FREE) {
+                free_cranes.push_back(i);
+            }
+        }
+        for(const int t : cr_tasks) {
+            handles.push_back(t);
+        }
+        if(free_cranes.empty() || handles.empty()) {
+            return;
+        }
+        const int rows = free_cranes.size();
+        const int tasks = handles.size();
+        vector<vector<long long>> cost(rows, vector<long long>(tasks + rows, idle_cost));
+        for(int r = 0; r < rows; r++) {
+            for(int c = 0; c < tasks; c++) {
+                const int d = assignment_cost(free_cranes[r], handles[c]);
+                cost[r][c] = (d == -1 ? infeasible : d + (engine ? (*engine)() % (task_noise + 1) : 0));
+            }
+        }
+        const vector<int> match = min_cost_assignment(cost);
+        for(int r = 0; r < rows; r++) {
+            const int c = match[r];
+            if(c >= tasks || cost[r][c] >= infeasible) {
+                continue;
             }
-        };
+            const int t = handles[c];
+            const CR_task& cr = cr_tasks[t];
+            if(cr_tasks.find_catch(cr.catch_i*n + cr.catch_j, cr.large_job) != t) {
+                retry = true;
+                continue;
+            }
+            assign(free_cranes[r], t);
+        }
+    }
+}
 
-        // 移動タスクのリストを更新する
-        term.update1();
-        update_cr_tasks();
-        cerr << "cr_tasks.size() = " << cr_tasks.size() << endl;
-        for(auto cr: cr_tasks) {
-            cerr << cr.catch_i << "," << cr.catch_j << "->" << cr.release_i << "," << cr.release_j << endl;
+// 全クレーンの経路をまとめて計画する。
+void Dispatcher::plan_paths(mt19937& engine) {
+    PROFILE_SCOPE(plan_paths);
+    int goals[n];
+    bool pinned[n];
+    for(int i = 0; i < n; i++) {
+        const Crane& c = term.cranes[i];
+        const int cur = c.i*n + c.j;
+        goals[i] = -1;
+        pinned[i] = false;
+        if(c.status == CraneStatus::PRE_CATCH || c.status == CraneStatus::CATCH_NOW) {
+            goals[i] = c.catch_i*n + c.catch_j;
+        } else if(c.status == CraneStatus::PRE_RELEASE || c.status == CraneStatus::RELEASE_NOW) {
+            goals[i] = c.release_i*n + c.release_j;
         }
-        for(int i = 0; i < n; i++) {
-            cerr << "crane #" << i << ": " << term.cranes[i]->status << endl;
+        pinned[i] = (goals[i] == cur);
+    }
+    planner.plan(term, goals, pinned, engine, stalled());
+}
+
+// 経路を計画して行動を決め、ターンを進める
+void Dispatcher::end_turn(mt19937& engine) {
+    plan_paths(engine);
+
+    // 各クレーンの行動を決定する。予約は割り当てを終えた後のもの
+    update_crane_reserved();
+    const uint32_t reserved = reserved_cells();
+    vector<ActionType> actions(n, ActionType::WAIT);
+    for(int i = 0; i < n; i++) {
+        actions[i] = get_next_action(i, planner.next_cell(i), stay_count[i], reserved, term, res);
+        const auto [di, dj] = common::act2move(actions[i]);
+        stay_count[i] = (di == 0 && dj == 0 ? stay_count[i] + 1 : 0);
+    } 
+    const bool progress = any_of(actions.begin(), actions.end(), [](ActionType act) {
+        return act == ActionType::CATCH || act == ActionType::RELEASE;
+    });
+    stall_count = progress ? 0 : stall_count + 1;
+
+    term.update2(actions);
+    term.update3();
+    res.push_back(actions);
+
+    if(verbose) LOG_DEBUG("turn_count (solver_001) = " << term.turn_count);
+}
+
+vector<vector<ActionType>> solve() {
+
+    Dispatcher dispatcher;
+    dispatcher.init(in, true);
+
+    // iterates step3 and step4
+    while(dispatcher.term.turn_count < MAX_TURN) {
+        if(!dispatcher.begin_turn()) {
+            break;
         }
+        dispatcher.assign_free_cranes();
+        dispatcher.end_turn(ryuka.engine);
+    }
+    return dispatcher.res.unpack();
 
-        // 各クレーンの行動を決定する。
-        vector<ActionType> actions(n, ActionType::WAIT);
-        vector<vector<shared_ptr<Crane>>> next_crane_pos(n, vector<shared_ptr<Crane>>(n, nullptr)); 
+}
 
-        for(int i = 0; i < n; i++) {
-            if(!term.cranes[i]->exist) {
-                actions[i] = ActionType::DESTROYED;
-                continue;
-            }
-            // 手持無沙汰な場合、適当なタスクをあてがう。
-            if(term.cranes[i]->status == CraneStatus::FREE) {
-                int best_task_id = -1;
-                int min_dist = 100000;
-                for(int t = 0; t < cr_tasks.size(); t++) {
-                    if(!term.container_pos[cr_tasks[t].catch_i][cr_tasks[t].catch_j]) {
-                        continue;
-                    }
-                    if(i != 0 && cr_tasks[t].large_job) {
-                        continue;
-                    }
-                    int dist =  abs(term.cranes[i]->i - cr_tasks[t].catch_i) +
-                                abs(term.cranes[i]->j - cr_tasks[t].catch_j);
-                    if(term.cranes[i]->prev_container_id == term.container_pos[cr_tasks[t].catch_i][cr_tasks[t].catch_j]->id) {
-                        if(term.cranes[i]->crane_type == CraneType::LARGE) {
-                            dist += 1000;
-                        } else {
-                            dist += 1000000;
-                        }
-                    }
-                    if(min_dist > dist) {
-                        min_dist = dist;
-                        best_task_id = t;
-                    }
-                }
-                if(best_task_id != -1) {
-                    const CR_task cr = cr_tasks[best_task_id];
-                    cerr << "cr " << i << ":" << cr.catch_i << "," << cr.catch_j << "->" << cr.release_i << "," << cr.release_j << endl;
-                    term.cranes[i]->set_catch_and_release(cr.catch_i, cr.catch_j, cr.release_i, cr.release_j);
-                    //cr_tasks.erase(cr_tasks.begin() + best_task_id);
-                    erase_cr_tasks(cr.catch_i, cr.catch_j);
+// restart r の解。乱数は master_seed から r ごとに導いた系列だけを使う。
+// r = 0 はゆらぎなしの貪欲解
+// incumbent より短くならないとわかった時点で打ち切る（結果は途中までの解）
+// lookahead_deadline > 0 なら先読みを使い、その締め切りまでの残り時間に応じて先読みを小さくする
+PackedActions run_restart(uint64_t master_seed, int r, const Incumbent& incumbent, double lookahead_deadline = 0) {
+    mt19937 engine(RandGenerator::derive(master_seed, r));
+    Dispatcher dispatcher;
+    dispatcher.init(in, false);
+    while(dispatcher.term.turn_count < MAX_TURN) {
+        if(dispatcher.res.size() >= incumbent.bound() || incumbent.stopped()) {
+            break;
+        }
+        if(!dispatcher.begin_turn()) {
+            break;
+        }
+        if(lookahead_deadline > 0) {
+            dispatcher.lookahead = lookahead_for(lookahead_deadline - toki.elapsed());
+        }
+        dispatcher.assign_free_cranes(r == 0 ? nullptr : &engine);
+        dispatcher.end_turn(engine);
+    }
+    return dispatcher.res;
+}
+
+// restarts 回の独立な試行を ctx.threads 本のスレッドで分担し、改善するたびに incumbent へ出す。
+// 同点なら番号の小さい試行を選ぶので、締め切りまでに全試行が終わり、ほかのソルバーに
+// 打ち切られることもなければ、結果は ctx.seed と restarts だけで決まり、スレッド数によらない。
+// 全試行が終わって時間が余れば、締め切りまで先読みつきの試行を続ける（こちらは時間次第）
+vector<vector<ActionType>> solve_restarts(const Context& ctx, int restarts, double deadline, Incumbent& incumbent) {
+    vector<long long> scores(restarts, common::INVALID_SCORE);
+    vector<PackedActions> results(restarts);
+    atomic<int> next_restart(0);
+    const int threads = max(1, ctx.threads);
+    // 先読みつきの試行で各スレッドが見つけた最良の解
+    vector<long long> extra_scores(threads, common::INVALID_SCORE);
+    vector<PackedActions> extra_results(threads);
+    auto worker = [&](int tid) -> void {
+        // in はスレッドごとなので、呼び出し元の入力を写しておく
+        in = ctx.in;
+        while(toki.elapsed() < deadline && !incumbent.stopped()) {
+            const int r = next_restart++;
+            PROFILE_COUNT(restarts);
+            PackedActions result;
+            long long score;
+            if(r < restarts) {
+                result = results[r] = run_restart(ctx.seed, r, incumbent);
+                score = scores[r] = common::score(in, result.unpack());
+            } else {
+                result = run_restart(ctx.seed, r, incumbent, deadline);
+                score = common::score(in, result.unpack());
+                if(score < extra_scores[tid]) {
+                    extra_scores[tid] = score;
+                    extra_results[tid] = result;
                 }
             }
-            ActionType act = get_next_action(i, next_crane_pos, term, res);
-            actions[i] = act;
-
-            // next_posを更新する
-            {
-                auto [di, dj] = common::act2move(actions[i]);
-                const int next_i = term.cranes[i]->i + di;
-                const int next_j = term.cranes[i]->j + dj;
-                next_crane_pos[next_i][next_j] = term.cranes[i]; 
+            if(score < incumbent.bound()) {
+                incumbent.publish(ctx, result);
             }
-        } 
-
-        term.update2(actions);
-        term.update3();
-        copy2res(res, actions);
-
-        cerr << "turn_count (solver_001) = " << term.turn_count << endl;
+        }
+    };
+    vector<thread> pool;
+    for(int t = 0; t < threads; t++) {
+        pool.emplace_back(worker, t);
     }
-    return res;
+    for(thread& th : pool) {
+        th.join();
+    }
+    const int best = min_element(scores.begin(), scores.end()) - scores.begin();
+    const int best_extra = min_element(extra_scores.begin(), extra_scores.end()) - extra_scores.begin();
+    LOG_INFO("restarts (solver_001) = " << (int)next_restart);
+    LOG_INFO("best_restart (solver_001) = " << best);
+    if(extra_scores[best_extra] < scores[best]) {
+        LOG_INFO("lookahead restart wins (solver_001) = " << extra_scores[best_extra]);
+        return extra_results[best_extra].unpack();
+    }
+    return results[best].unpack();
+}
 
+void solve(const Context& ctx, double deadline, Incumbent& incumbent) {
+    PROFILE_SCOPE(solver_001);
+    solve_restarts(ctx, restart_count, deadline, incumbent);
 }
 
 }; // namespace solver_001
@@ -0,0 +1,156 @@
+#ifndef __SOLVER_002_HPP__
+#define __SOLVER_002_HPP__
+
+#include "common.hpp"
+#include "ryuka.hpp"
+#include "toki.hpp"
+#include "solver_001.hpp"
+#include "anytime.hpp"
+#include <algorithm>
+#include <unordered_set>
+#include <tuple>
+
+extern thread_local Input in;
+extern thread_local RandGenerator ryuka;
+extern Timer toki;
+
+namespace solver_002 {
+
+// 手持無沙汰なクレーンに試すタスク候補の数
+constexpr int branch = 3;
+// ビーム幅は 1 ターンに 2 倍までしか広げない。上限はメモリで決める（1 ノード数 KB）
+constexpr int max_width = 8192;
+
+using sovler_001::Dispatcher;
+using sovler_001::evaluate;
+
+struct Node {
+    Dispatcher dispatcher;
+    long long eval;
+};
+
+// 盤面とクレーンの受け持ちタスクが同じ状態をまとめるためのキー
+uint64_t node_key(const Dispatcher& d) {
+    uint64_t key = d.term.hash;
+    for(int i = 0; i < n; i++) {
+        const Crane& c = d.term.cranes[i];
+        const uint64_t task = (uint64_t)c.status << 24 | (uint64_t)(uint8_t)c.catch_i << 18 | (uint64_t)(uint8_t)c.catch_j << 12
+                            | (uint64_t)(uint8_t)c.release_i << 6 | (uint64_t)(uint8_t)c.release_j;
+        key ^= (task + 1) * 0x9e3779b97f4a7c15ull * (i + 1);
+    }
+    return key;
+}
+
+// 搬出し終えた解は改善するたびに incumbent へ出す。incumbent より良くならないとわかれば打ち切る。
+// 締め切りを過ぎたらそこでやめる
+void solve(const Context& ctx, double deadline, Incumbent& incumbent) {
+    PROFILE_SCOPE(solver_002);
+
+    vector<Node> beam(1);
+    beam[0].dispatcher.init(in, false);
+    beam[0].eval = evaluate(beam[0].dispatcher.term);
+
+    PackedActions best;
+    long long best_score = common::INVALID_SCORE;
+    int width = 64;
+
+    while(!beam.empty() && beam[0].dispatcher.term.turn_count < MAX_TURN && !incumbent.stopped() && toki.elapsed() < deadline) {
+        const double turn_start = toki.elapsed();
+        vector<Node> next;
+        next.reserve(beam.size() * branch);
+        auto push = [&](Dispatcher& d) -> void {
+            d.end_turn(ryuka.engine);
+            PROFILE_COUNT(beam_nodes);
+            next.push_back(Node{d, evaluate(d.term)});
+        };
+        for(Node& node : beam) {
+            Dispatcher& d = node.dispatcher;
+            if(!d.begin_turn()) {
+                continue;
+            }
+            // 最初の手持無沙汰なクレーンについて、割り当てコスト（assign_free_cranes と同じもの）の
+            // 小さいタスクから branch 個を試す。同じコストなら登録順を優先する
+            int free_crane = -1;
+            vector<tuple<int, int, int>> candidates;
+            for(int i = 0; i < n && free_crane == -1; i++) {
+                if(!d.term.cranes[i].exist || d.term.cranes[i].status != CraneStatus::FREE) {
+                    continue;
+                }
+                int rank = 0;
+                for(const int t : d.cr_tasks) {
+                    const int cost = d.assignment_cost(i, t);
+                    if(cost != -1) {
+                        candidates.emplace_back(cost, rank, t);
+                    }
+                    rank++;
+                }
+                if(!candidates.empty()) {
+                    free_crane = i;
+                }
+            }
+            if(free_crane == -1) {
+                d.assign_free_cranes();
+                push(d);
+                continue;
+            }
+            const int k = min((int)candidates.size(), branch);
+            partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+            for(int c = 0; c < k; c++) {
+                Dispatcher child = (c + 1 == k ? move(d) : d);
+                child.assign(free_crane, get<2>(candidates[c]));
+                child.assign_free_cranes();
+                push(child);
+            }
+        }
+
+        // 搬出し終えた候補を採点する。同じターンに終わった中で最良のものが残る
+        for(const Node& node : next) {
+            if(node.dispatcher.finished()) {
+                const long long score = common::score(in, node.dispatcher.res.unpack());
+                if(score < best_score) {
+                    best_score = score;
+                    best = node.dispatcher.res;
+                    incumbent.publish(ctx, best);
+                }
+            }
+        }
+        // 以降に終わる候補はターン数だけでもこれ以上良くならない
+        if(!next.empty() && min(best_score, incumbent.bound()) <= next[0].dispatcher.term.turn_count + 1) {
+            // beam の中身は next へ移してあるので、途中解として使わない
+            beam.clear();
+            break;
+        }
+
+        // 同一状態を除き、評価の高い順に width 個残す
+        sort(next.begin(), next.end(), [](const Node& a, const Node& b) { return a.eval > b.eval; });
+        unordered_set<uint64_t> seen;
+        beam.clear();
+        for(Node& node : next) {
+            if((int)beam.size() >= width) {
+                break;
+            }
+            if(node.dispatcher.finished() || !seen.insert(node_key(node.dispatcher)).second) {
+                continue;
+            }
+            beam.push_back(move(node));
+        }
+
+        // 残り時間に収まるようにビーム幅を調整する。時間が余っていれば広げる
+        if(!next.empty() && !beam.empty()) {
+            const double per_child = max(1e-7, (toki.elapsed() - turn_start) / next.size());
+            const double remaining = deadline - toki.elapsed();
+            const int remaining_turns = 8 * beam[0].dispatcher.term.remaining_containers() + 10;
+            width = clamp((int)(remaining / (remaining_turns * branch * per_child)), 1, min(max_width, 2 * width));
+        }
+    }
+
+    if(best_score == common::INVALID_SCORE && !beam.empty()) {
+        incumbent.publish(ctx, beam[0].dispatcher.res);
+    }
+    LOG_INFO("score (solver_002) = " << best_score);
+
+}
+
+} // namespace solver_002
+
+#endif
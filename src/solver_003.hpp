@@ -0,0 +1,43 @@
+#ifndef __SOLVER_003_HPP__
+#define __SOLVER_003_HPP__
+
+#include "common.hpp"
+#include "toki.hpp"
+#include "state.hpp"
+#include "annealer.hpp"
+#include "anytime.hpp"
+
+extern thread_local Input in;
+extern Timer toki;
+
+namespace solver_003 {
+
+// レプリカ交換法の温度の範囲。スコア差 1 は 1 ターンに相当する
+constexpr double temp_min = 0.5;
+constexpr double temp_max = 10.0;
+// スレッドが少なくても、温度の異なる鎖を最低これだけ走らせる
+constexpr int min_replicas = 4;
+constexpr int exchange_interval = 32;
+
+// solver_001 の貪欲なタスク割り当てを遺伝子として、レプリカ交換法で探索する
+void solve(const Context& ctx, double deadline, Incumbent& incumbent) {
+    PROFILE_SCOPE(solver_003);
+
+    State initial_state = State::initState();
+    // 貪欲解より大幅に長引くデコードは打ち切る
+    initial_state.turn_limit = min(MAX_TURN, 2 * (int)initial_state.result.size() + 10);
+
+    incumbent.publish(ctx, initial_state.result);
+
+    IterationControl<State> sa;
+    sa.cancelled = &incumbent.cancelled;
+    const int replicas = max(min_replicas, ctx.threads);
+    const State best_state = sa.temper(deadline - toki.elapsed(), temp_min, temp_max, initial_state, replicas, exchange_interval, ctx.threads);
+    LOG_INFO("score (solver_003) = " << -best_state.score);
+    incumbent.publish(ctx, best_state.result);
+
+}
+
+} // namespace solver_003
+
+#endif
@@ -3,19 +3,40 @@
 
 #include "common.hpp"
 #include "ryuka.hpp"
+#include "solver_001.hpp"
 #include <numeric>
 #include <algorithm>
+#include <memory>
 
 using namespace std;
 
-extern Input in;
-extern RandGenerator ryuka;
+extern thread_local Input in;
+extern thread_local RandGenerator ryuka;
 
+using sovler_001::Dispatcher;
+
+// dispatcher state right before decision number k: a free crane picks one of its candidate tasks
+struct Checkpoint {
+    Dispatcher dispatcher;
+    int crane;          // crane that decides; cranes before it already did this turn
+    int candidates;     // number of tasks it may take
+};
+
+// genes[k] selects the genes[k]-th cheapest task at the k-th decision of the greedy
+// dispatcher (0 = greedy choice). decoding keeps a checkpoint per decision, so a
+// neighbour only re-simulates from its first changed decision; checkpoints before that
+// are shared with the parent state.
 struct State {
     static constexpr long long inf = 1LL<<60;
-    long long score;
-    State() : score(-inf) {};
+    long long score;                    // -common::score, larger is better
+    const Input* input;                 // carried along so any thread can decode
+    int turn_limit;                     // decoding gives up after this many turns
+    vector<int> genes;
+    vector<shared_ptr<const Checkpoint>> checkpoints;
+    PackedActions result;
+    State() : score(-inf), input(&in), turn_limit(MAX_TURN) {};
     long long calc_score();
+    void simulate(int from);
     static State initState();
     static State generateState(const State& input_state);
 };
@@ -24,14 +45,104 @@ long long State::calc_score() {
     return score;
 }
 
+// candidate tasks of crane i, cheapest first and in registry order among equal costs.
+// costs are the dispatcher's assignment_cost, so gene 0 is the task the matching would
+// give crane i if it had no other crane to share with
+vector<int> sorted_tasks(const Dispatcher& d, int i) {
+    vector<pair<int, int>> cost_id;
+    for(const int t : d.cr_tasks) {
+        const int cost = d.assignment_cost(i, t);
+        if(cost != -1) {
+            cost_id.emplace_back(cost, t);
+        }
+    }
+    stable_sort(cost_id.begin(), cost_id.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    vector<int> res;
+    for(auto [cost, t] : cost_id) {
+        res.push_back(t);
+    }
+    return res;
+}
+
+// decodes genes from decision number from onwards
+void State::simulate(int from) {
+    Dispatcher d;
+    int crane = 0;
+    if(from < (int)checkpoints.size()) {
+        d = checkpoints[from]->dispatcher;
+        crane = checkpoints[from]->crane;
+    } else {
+        from = 0;
+        d.init(*input, false);
+        if(!d.begin_turn()) {
+            return;
+        }
+    }
+    checkpoints.resize(from);
+    int k = from;
+    while(true) {
+        for(int i = crane; i < n; i++) {
+            if(!d.term.cranes[i].exist || d.term.cranes[i].status != CraneStatus::FREE) {
+                continue;
+            }
+            const vector<int> tasks = sorted_tasks(d, i);
+            if(tasks.empty()) {
+                continue;
+            }
+            checkpoints.push_back(make_shared<const Checkpoint>(Checkpoint{d, i, (int)tasks.size()}));
+            if(k >= (int)genes.size()) {
+                genes.push_back(0);
+            }
+            d.assign(i, tasks[genes[k] % tasks.size()]);
+            k++;
+        }
+        // 経路計画の乱数はターン数だけで決まるようにして、デコードを決定的にする
+        mt19937 engine(d.term.turn_count);
+        d.end_turn(engine);
+        crane = 0;
+        if(d.term.turn_count >= turn_limit || !d.begin_turn()) {
+            break;
+        }
+    }
+    genes.resize(k);
+    result = d.res;
+    score = -common::score(d.term, result.size());
+}
+
 State State::initState() {
     State res;
-    res.calc_score();
+    res.simulate(0);
     return res;
 }
 
+// neighbourhoods: reassign one decision, swap two decisions, or move one decision elsewhere
 State State::generateState(const State& input_state) {
+    PROFILE_SCOPE(neighbour);
     State res = input_state;
+    const int m = res.genes.size();
+    if(m == 0) {
+        return res;
+    }
+    const int type = ryuka.rand(3);
+    int from = 0;
+    if(type == 0 || m < 2) {
+        const int k = ryuka.rand(m);
+        res.genes[k] = ryuka.rand(res.checkpoints[k]->candidates);
+        from = k;
+    } else if(type == 1) {
+        const int a = ryuka.rand(m);
+        const int b = ryuka.rand(m);
+        swap(res.genes[a], res.genes[b]);
+        from = min(a, b);
+    } else {
+        const int a = ryuka.rand(m);
+        const int b = ryuka.rand(m);
+        const int gene = res.genes[a];
+        res.genes.erase(res.genes.begin() + a);
+        res.genes.insert(res.genes.begin() + b, gene);
+        from = min(a, b);
+    }
+    res.simulate(from);
     res.calc_score();
     return res;
 }
@@ -1,24 +1,82 @@
 #ifndef __TOKI_HPP__
 #define __TOKI_HPP__
 
-#include <sys/time.h>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TOKI_HAS_TSC 1
+#endif
 
+// monotonic clock in seconds. reads the invariant tsc when the cpu has one, calibrated
+// once against steady_clock; otherwise falls back to steady_clock itself. neither
+// jumps with the wall clock, and gettime is safe to call from any thread.
 struct Timer {
 
+    static constexpr double calibration_time = 2e-3;
     double global_start;
-    
-    double gettime() {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        return tv.tv_sec + tv.tv_usec * 1e-6;
+    bool use_tsc;
+    uint64_t tsc_base;              // tsc reading taken at time_base
+    double time_base;
+    double seconds_per_tick;
+
+    Timer() : global_start(0), use_tsc(false), tsc_base(0), time_base(0), seconds_per_tick(0) {
+        calibrate();
+    }
+
+    static double steady() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
     }
-    
+
+    static bool invariant_tsc() {
+#ifdef TOKI_HAS_TSC
+        unsigned int a, b, c, d;
+        return __get_cpuid(0x80000007, &a, &b, &c, &d) && (d >> 8 & 1);
+#else
+        return false;
+#endif
+    }
+
+    // spins for calibration_time to measure the tsc rate
+    void calibrate() {
+        use_tsc = false;
+#ifdef TOKI_HAS_TSC
+        if(!invariant_tsc()) {
+            return;
+        }
+        const double t0 = steady();
+        const uint64_t c0 = __rdtsc();
+        double t1 = t0;
+        while(t1 - t0 < calibration_time) {
+            t1 = steady();
+        }
+        const uint64_t c1 = __rdtsc();
+        if(c1 <= c0) {
+            return;
+        }
+        seconds_per_tick = (t1 - t0) / (c1 - c0);
+        tsc_base = c1;
+        time_base = t1;
+        use_tsc = true;
+#endif
+    }
+
+    double gettime() const {
+#ifdef TOKI_HAS_TSC
+        if(use_tsc) {
+            return time_base + (int64_t)(__rdtsc() - tsc_base) * seconds_per_tick;
+        }
+#endif
+        return steady();
+    }
+
     void init() {
         global_start = gettime();
     }
-    
-    double elapsed() {
+
+    double elapsed() const {
         return gettime() - global_start;
     }
 } toki;
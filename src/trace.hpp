@@ -0,0 +1,219 @@
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include "common.hpp"
+#include <fstream>
+#include <string>
+
+// binary trace of one run: input, RNG seed, per-turn actions and a Terminal snapshot
+// every snapshot_interval turns (0: none). layout, all little-endian:
+//   "AHCT" | version u32 | sizeof(Terminal) u32 | a[n][n] i8 | seed u64
+//   | snapshot_interval i32 | turns i32 | turns x 3 bytes (n 4-bit actions)
+//   | snapshots i32 | snapshots x Terminal (state after k*snapshot_interval turns)
+struct Trace {
+    static constexpr uint32_t version = 1;
+    Input in;
+    uint64_t seed;
+    int snapshot_interval;
+    vector<uint32_t> actions;       // n 4-bit actions per turn
+    vector<Terminal> snapshots;
+    void init(const Input&, uint64_t seed, int snapshot_interval);
+    void record(const vector<ActionType>& acts, const Terminal& after);
+    static Trace build(const Input&, uint64_t seed, const vector<vector<ActionType>>&, int snapshot_interval);
+    int turns() const { return actions.size(); }
+    vector<ActionType> turn(int t) const;
+    bool save(const string& path) const;
+    bool load(const string& path);
+    bool verify() const;
+};
+
+// restores the nearest snapshot at or before the requested turn and re-simulates from there.
+// every replayed turn goes through referee2, as the actions may have been edited after
+// load verified them: an illegal turn is reported and not applied, so term stays at the
+// last legal turn
+struct Replayer {
+    const Trace* trace;
+    Terminal term;
+    void init(const Trace& _trace) { trace = &_trace; term.init(trace->in); }
+    SimStatus step();
+    SimStatus seek(int turn);
+};
+
+void Trace::init(const Input& _in, uint64_t _seed, int _snapshot_interval) {
+    in = _in;
+    seed = _seed;
+    snapshot_interval = _snapshot_interval;
+    actions.clear();
+    snapshots.clear();
+}
+
+// call after update3 of each turn
+void Trace::record(const vector<ActionType>& acts, const Terminal& after) {
+    uint32_t packed = 0;
+    for(int k = 0; k < n; k++) {
+        packed |= (uint32_t)acts[k] << (4*k);
+    }
+    actions.push_back(packed);
+    if(snapshot_interval > 0 && turns() % snapshot_interval == 0) {
+        snapshots.push_back(after);
+    }
+}
+
+// replays res the way common::referee does; the trace ends before the first illegal turn
+Trace Trace::build(const Input& in, uint64_t seed, const vector<vector<ActionType>>& res, int snapshot_interval) {
+    Trace trace;
+    trace.init(in, seed, snapshot_interval);
+    Terminal term;
+    term.init(in);
+    int len = 0;
+    for(const auto& row : res) {
+        len = max(len, (int)row.size());
+    }
+    vector<ActionType> acts(n);
+    for(int t = 0; t < len; t++) {
+        for(int k = 0; k < n; k++) {
+            if(k < (int)res.size() && t < (int)res[k].size()) {
+                acts[k] = res[k][t];
+            } else {
+                acts[k] = term.cranes[k].exist ? ActionType::WAIT : ActionType::DESTROYED;
+            }
+        }
+        term.update1();
+        if(!term.referee2(acts).ok()) {
+            break;
+        }
+        term.update3();
+        trace.record(acts, term);
+    }
+    return trace;
+}
+
+vector<ActionType> Trace::turn(int t) const {
+    vector<ActionType> res(n);
+    for(int k = 0; k < n; k++) {
+        res[k] = (ActionType)(actions[t] >> (4*k) & 15);
+    }
+    return res;
+}
+
+bool Trace::save(const string& path) const {
+    ofstream ofs(path, ios::binary);
+    if(!ofs) {
+        return false;
+    }
+    auto put = [&](const auto& x) { ofs.write((const char*)&x, sizeof(x)); };
+    ofs.write("AHCT", 4);
+    put(version);
+    put((uint32_t)sizeof(Terminal));
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n; j++) {
+            put((int8_t)in.a[i][j]);
+        }
+    }
+    put(seed);
+    put(snapshot_interval);
+    put(turns());
+    for(const uint32_t packed : actions) {
+        ofs.write((const char*)&packed, 3);
+    }
+    put((int)snapshots.size());
+    ofs.write((const char*)snapshots.data(), snapshots.size() * sizeof(Terminal));
+    return (bool)ofs;
+}
+
+bool Trace::load(const string& path) {
+    ifstream ifs(path, ios::binary);
+    auto get = [&](auto& x) { ifs.read((char*)&x, sizeof(x)); };
+    char magic[4];
+    ifs.read(magic, 4);
+    uint32_t file_version, terminal_size;
+    get(file_version);
+    get(terminal_size);
+    if(!ifs || memcmp(magic, "AHCT", 4) != 0 || file_version != version || terminal_size != sizeof(Terminal)) {
+        return false;
+    }
+    in.a.assign(n, vector<int>(n));
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n; j++) {
+            int8_t x;
+            get(x);
+            in.a[i][j] = x;
+        }
+    }
+    get(seed);
+    get(snapshot_interval);
+    int len = -1;
+    get(len);
+    if(!ifs || len < 0 || len > MAX_TURN) {
+        return false;
+    }
+    actions.assign(len, 0);
+    for(uint32_t& packed : actions) {
+        ifs.read((char*)&packed, 3);
+    }
+    int count = -1;
+    get(count);
+    if(!ifs || count < 0 || count > len) {
+        return false;
+    }
+    snapshots.resize(count);
+    ifs.read((char*)snapshots.data(), count * sizeof(Terminal));
+    return ifs && verify();
+}
+
+// replays every turn through referee2; the snapshots have to agree with the replay, as
+// Replayer::seek restores them without replaying the turns before them
+bool Trace::verify() const {
+    Terminal term;
+    term.init(in);
+    size_t k = 0;
+    for(int t = 0; t < turns(); t++) {
+        term.update1();
+        if(!term.referee2(turn(t)).ok()) {
+            return false;
+        }
+        term.update3();
+        if(snapshot_interval > 0 && term.turn_count % snapshot_interval == 0 && k < snapshots.size()) {
+            const Terminal& snapshot = snapshots[k++];
+            if(snapshot.turn_count != term.turn_count || snapshot.hash != term.hash) {
+                return false;
+            }
+        }
+    }
+    return k == snapshots.size();
+}
+
+SimStatus Replayer::step() {
+    const Terminal before = term;
+    term.update1();
+    const SimStatus status = term.referee2(trace->turn(term.turn_count - 1));
+    if(status.ok()) {
+        term.update3();
+    } else {
+        term = before;
+    }
+    return status;
+}
+
+// stops at the first illegal turn on the way and returns its status
+SimStatus Replayer::seek(int turn) {
+    assert(0 <= turn && turn <= trace->turns());
+    const int k = trace->snapshot_interval > 0 ? min(turn / trace->snapshot_interval, (int)trace->snapshots.size()) : 0;
+    // moving forward from the current state is cheaper than restoring when it is closer
+    if(!(term.turn_count <= turn && (k == 0 || term.turn_count >= k * trace->snapshot_interval))) {
+        if(k == 0) {
+            term.init(trace->in);
+        } else {
+            term = trace->snapshots[k-1];
+        }
+    }
+    while(term.turn_count < turn) {
+        const SimStatus status = step();
+        if(!status.ok()) {
+            return status;
+        }
+    }
+    return SimStatus{SimError::ERR_NONE, term.turn_count, -1};
+}
+
+#endif